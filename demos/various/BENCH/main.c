@@ -0,0 +1,941 @@
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "chmtx.h"
+#include "ring.h"
+#include "bring.h"
+#include "rwlock.h"
+#include "mpmc.h"
+#include "record.h"
+#include "prng.h"
+#include <string.h>
+#include <stdlib.h>
+
+static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
+
+#define BUFFER_SIZE 16       // Степень двойки для ring.h
+#define BENCH_ITEMS 100000   // Элементов на один прогон
+#define BENCH_BATCH 8        // Размер пачки для пакетных стратегий
+#define RT_FREQUENCY 1000000 // SIMIA32: счетчик реального времени в мкс (gettimeofday)
+#define TICKET_THREADS 10    // Потоков-пользователей в тикет-бенчмарке
+#define TICKET_OPS 10000     // Операций на поток
+#define TICKET_LOCK_TIMEOUT TIME_MS2I(5) // Как BUFFER_LOCK_TIMEOUT в LAB3_VARIANT3
+#define PIPE_SIZE 256        // Байт в канале для бенчмарка записей
+#define PIPE_RECORDS 20000   // Записей на один прогон
+#define PIPE_BURST 8         // Записей в одной chPipeWriteTimeout()
+#define PIPE_RECORD_MAX 64   // Самое длинное тело записи
+#define MSG_ITEMS 20000      // Сообщений на один прогон бенчмарка размера
+#define MSG_SIZE_MAX 4096    // Самое длинное сообщение
+
+// Стратегия обмена производитель -> потребитель.
+// Пакетные стратегии задают put_n/get_n вместо put/get. Необязательные
+// wait_put/wait_get вызываются вместо chThdYield(), когда буфер полон / пуст,
+// attach/detach - в начале и в конце потока потребителя. superloop - оба
+// конца в одном потоке, как главный цикл LAB2
+typedef struct {
+    const char *name;
+    void (*reset)(void);
+    bool (*put)(int value);
+    bool (*get)(int *value);
+    size_t (*put_n)(const int *src, size_t n);
+    size_t (*get_n)(int *dst, size_t max);
+    void (*wait_put)(void);
+    void (*wait_get)(void);
+    void (*attach)(void);
+    void (*detach)(void);
+    bool superloop;
+} BenchStrategy;
+
+// Кольцевой буфер под мьютексом, как был в LAB3/main.c
+static int mtx_buffer[BUFFER_SIZE];
+static size_t mtx_head, mtx_tail, mtx_count;
+static mutex_t mtx_buffer_mutex;
+
+static void mtx_reset(void) {
+    mtx_head = 0;
+    mtx_tail = 0;
+    mtx_count = 0;
+    chMtxObjectInit(&mtx_buffer_mutex);
+}
+
+static bool mtx_put(int value) {
+    chMtxLock(&mtx_buffer_mutex);
+    if (mtx_count == BUFFER_SIZE) {
+        chMtxUnlock(&mtx_buffer_mutex);
+        return false;
+    }
+    mtx_buffer[mtx_head] = value;
+    mtx_head = (mtx_head + 1) % BUFFER_SIZE;
+    mtx_count++;
+    chMtxUnlock(&mtx_buffer_mutex);
+    return true;
+}
+
+static bool mtx_get(int *value) {
+    chMtxLock(&mtx_buffer_mutex);
+    if (mtx_count == 0) {
+        chMtxUnlock(&mtx_buffer_mutex);
+        return false;
+    }
+    *value = mtx_buffer[mtx_tail];
+    mtx_tail = (mtx_tail + 1) % BUFFER_SIZE;
+    mtx_count--;
+    chMtxUnlock(&mtx_buffer_mutex);
+    return true;
+}
+
+// Тот же буфер под мьютексом, потребитель спит на событии, которое
+// производитель рассылает после каждой записи (как было в LAB3)
+static event_source_t evt_items;
+static event_listener_t evt_listener;
+
+static void evt_reset(void) {
+    mtx_reset();
+    chEvtObjectInit(&evt_items);
+}
+
+static bool evt_put(int value) {
+    if (!mtx_put(value)) {
+        return false;
+    }
+    chEvtBroadcast(&evt_items);
+    return true;
+}
+
+static void evt_wait_get(void) {
+    chEvtWaitAny(EVENT_MASK(0));
+}
+
+static void evt_attach(void) {
+    chEvtRegister(&evt_items, &evt_listener, 0);
+}
+
+static void evt_detach(void) {
+    chEvtUnregister(&evt_items, &evt_listener);
+}
+
+// Кольцо из ring.h под мьютексом, пачка за один захват (как LAB3_VARIANT2)
+static int mtx_batch_data[BUFFER_SIZE];
+static ring_t mtx_batch_ring;
+
+static void mtx_batch_reset(void) {
+    ring_init(&mtx_batch_ring, mtx_batch_data, sizeof(int), BUFFER_SIZE);
+    chMtxObjectInit(&mtx_buffer_mutex);
+}
+
+static size_t mtx_batch_put_n(const int *src, size_t n) {
+    chMtxLock(&mtx_buffer_mutex);
+    n = ring_put_n(&mtx_batch_ring, src, n);
+    chMtxUnlock(&mtx_buffer_mutex);
+    return n;
+}
+
+static size_t mtx_batch_get_n(int *dst, size_t max) {
+    chMtxLock(&mtx_buffer_mutex);
+    max = ring_get_n(&mtx_batch_ring, dst, max);
+    chMtxUnlock(&mtx_buffer_mutex);
+    return max;
+}
+
+// Lock-free SPSC кольцо из ring.h
+static int spsc_data[BUFFER_SIZE];
+static ring_t spsc_ring;
+
+static void spsc_reset(void) {
+    ring_init(&spsc_ring, spsc_data, sizeof(int), BUFFER_SIZE);
+}
+
+static bool spsc_put(int value) {
+    return ring_put(&spsc_ring, &value);
+}
+
+static bool spsc_get(int *value) {
+    return ring_get(&spsc_ring, value);
+}
+
+static size_t spsc_put_n(const int *src, size_t n) {
+    return ring_put_n(&spsc_ring, src, n);
+}
+
+static size_t spsc_get_n(int *dst, size_t max) {
+    return ring_get_n(&spsc_ring, dst, max);
+}
+
+// Блокирующее кольцо на семафорах из bring.h: put/get не возвращают false
+static int blocking_data[BUFFER_SIZE];
+static bring_t blocking_ring;
+
+static void blocking_reset(void) {
+    bring_init(&blocking_ring, blocking_data, sizeof(int), BUFFER_SIZE);
+}
+
+static bool blocking_put(int value) {
+    return bring_put(&blocking_ring, &value, TIME_INFINITE) == MSG_OK;
+}
+
+static bool blocking_get(int *value) {
+    return bring_get(&blocking_ring, value, TIME_INFINITE) == MSG_OK;
+}
+
+static size_t blocking_put_n(const int *src, size_t n) {
+    return bring_put_n(&blocking_ring, src, n, TIME_INFINITE);
+}
+
+static size_t blocking_get_n(int *dst, size_t max) {
+    return bring_get_n(&blocking_ring, dst, max, TIME_INFINITE);
+}
+
+// Почтовый ящик ChibiOS с указателями на элементы из пула с семафором,
+// как LAB3 с BUFFER_USE_MAILBOX: пустой пул блокирует производителя,
+// пустой ящик - потребителя
+static int mbox_items[BUFFER_SIZE];
+static guarded_memory_pool_t mbox_pool;
+static msg_t mbox_data[BUFFER_SIZE];
+static mailbox_t mbox;
+
+static void mbox_reset(void) {
+    chGuardedPoolObjectInit(&mbox_pool, sizeof(int));
+    chGuardedPoolLoadArray(&mbox_pool, mbox_items, BUFFER_SIZE);
+    chMBObjectInit(&mbox, mbox_data, BUFFER_SIZE);
+}
+
+static bool mbox_put(int value) {
+    int *item = chGuardedPoolAllocTimeout(&mbox_pool, TIME_INFINITE);
+    *item = value;
+    return chMBPostTimeout(&mbox, (msg_t)item, TIME_INFINITE) == MSG_OK;
+}
+
+static bool mbox_get(int *value) {
+    msg_t msg;
+    if (chMBFetchTimeout(&mbox, &msg, TIME_INFINITE) != MSG_OK) {
+        return false;
+    }
+    int *item = (int *)msg;
+    *value = *item;
+    chGuardedPoolFree(&mbox_pool, item);
+    return true;
+}
+
+static const BenchStrategy strategies[] = {
+    {"superloop",  spsc_reset,      spsc_put,     spsc_get,     NULL,            NULL,
+     NULL, NULL,         NULL,       NULL,       true},
+    {"mutex",      mtx_reset,       mtx_put,      mtx_get,      NULL,            NULL,
+     NULL, NULL,         NULL,       NULL,       false},
+    {"mutex-evt",  evt_reset,       evt_put,      mtx_get,      NULL,            NULL,
+     NULL, evt_wait_get, evt_attach, evt_detach, false},
+    {"mutex-n",    mtx_batch_reset, NULL,         NULL,         mtx_batch_put_n, mtx_batch_get_n,
+     NULL, NULL,         NULL,       NULL,       false},
+    {"spsc",       spsc_reset,      spsc_put,     spsc_get,     NULL,            NULL,
+     NULL, NULL,         NULL,       NULL,       false},
+    {"spsc-n",     spsc_reset,      NULL,         NULL,         spsc_put_n,      spsc_get_n,
+     NULL, NULL,         NULL,       NULL,       false},
+    {"blocking",   blocking_reset,  blocking_put, blocking_get, NULL,            NULL,
+     NULL, NULL,         NULL,       NULL,       false},
+    {"blocking-n", blocking_reset,  NULL,         NULL,         blocking_put_n,  blocking_get_n,
+     NULL, NULL,         NULL,       NULL,       false},
+    {"mailbox",    mbox_reset,      mbox_put,     mbox_get,     NULL,            NULL,
+     NULL, NULL,         NULL,       NULL,       false},
+};
+#define STRATEGIES (sizeof(strategies) / sizeof(strategies[0]))
+
+// Результаты прогона для итоговой таблицы
+typedef struct {
+    uint32_t elapsed_us;
+    uint32_t rate;
+    uint32_t lat_mean;
+    uint32_t lat_p50;
+    uint32_t lat_p99;
+    uint32_t lat_max;
+    uint32_t ctxsw_x100; // Переключений контекста на элемент * 100
+    uint32_t retries;
+    uint32_t errors;
+} BenchResult;
+
+static BenchResult results[STRATEGIES];
+
+static const BenchStrategy *current;
+static uint32_t consumer_errors;
+static uint32_t retries; // Холостые пробуждения: неудачные put/get + chThdYield()
+
+// Задержка производитель -> потребитель: производитель ставит метку перед
+// последней попыткой записи элемента, потребитель вычисляет задержку по ней
+static rtcnt_t send_stamp[BENCH_ITEMS + 1];
+static rtcnt_t latency[BENCH_ITEMS];
+static size_t latency_count; // Задержки только совпавших элементов, подряд
+
+static void stamp_items(int first, size_t n) {
+    rtcnt_t now = chSysGetRealtimeCounterX();
+    for (size_t i = 0; i < n; i++) {
+        send_stamp[first + (int)i] = now;
+    }
+}
+
+static void receive_item(int value, int expected) {
+    if (value != expected) {
+        consumer_errors++;
+    } else {
+        latency[latency_count++] = chSysGetRealtimeCounterX() - send_stamp[value];
+    }
+}
+
+// Неудачная операция: ожидание стратегии или просто уступить процессор
+static void bench_wait(void (*wait)(void)) {
+    retries++;
+    if (wait != NULL) {
+        wait();
+    } else {
+        chThdYield();
+    }
+}
+
+// Производитель и потребитель уступают процессор, когда буфер полон / пуст
+static THD_WORKING_AREA(waProducer, 256);
+static THD_FUNCTION(Producer, arg) {
+    (void)arg;
+    
+    if (current->put_n != NULL) {
+        int batch[BENCH_BATCH];
+        int next = 1;
+        while (next <= BENCH_ITEMS) {
+            size_t n = 0;
+            while ((n < BENCH_BATCH) && (next + (int)n <= BENCH_ITEMS)) {
+                batch[n] = next + (int)n;
+                n++;
+            }
+            size_t done = 0;
+            while (done < n) {
+                stamp_items(next + (int)done, n - done);
+                size_t put = current->put_n(&batch[done], n - done);
+                if (put == 0) {
+                    bench_wait(current->wait_put);
+                }
+                done += put;
+            }
+            next += (int)n;
+        }
+        return;
+    }
+    
+    for (int i = 1; i <= BENCH_ITEMS; i++) {
+        stamp_items(i, 1);
+        while (!current->put(i)) {
+            bench_wait(current->wait_put);
+            stamp_items(i, 1);
+        }
+    }
+}
+
+static THD_WORKING_AREA(waConsumer, 256);
+static THD_FUNCTION(Consumer, arg) {
+    (void)arg;
+    
+    if (current->attach != NULL) {
+        current->attach();
+    }
+    
+    if (current->get_n != NULL) {
+        int batch[BENCH_BATCH];
+        int expected = 1;
+        while (expected <= BENCH_ITEMS) {
+            size_t got = current->get_n(batch, BENCH_BATCH);
+            if (got == 0) {
+                bench_wait(current->wait_get);
+            }
+            for (size_t i = 0; i < got; i++) {
+                receive_item(batch[i], expected++);
+            }
+        }
+    } else {
+        for (int i = 1; i <= BENCH_ITEMS; i++) {
+            int value;
+            while (!current->get(&value)) {
+                bench_wait(current->wait_get);
+            }
+            receive_item(value, i);
+        }
+    }
+    
+    if (current->detach != NULL) {
+        current->detach();
+    }
+}
+
+// Суперцикл: один поток заполняет буфер до отказа, затем выбирает его целиком
+static THD_FUNCTION(Superloop, arg) {
+    (void)arg;
+    int next = 1;
+    int expected = 1;
+    
+    while (expected <= BENCH_ITEMS) {
+        while (next <= BENCH_ITEMS) {
+            stamp_items(next, 1);
+            if (!current->put(next)) {
+                break;
+            }
+            next++;
+        }
+        int value;
+        while (current->get(&value)) {
+            receive_item(value, expected++);
+        }
+    }
+}
+
+static int compare_rtcnt(const void *a, const void *b) {
+    rtcnt_t x = *(const rtcnt_t *)a;
+    rtcnt_t y = *(const rtcnt_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_strategy(const BenchStrategy *bs, BenchResult *res) {
+    current = bs;
+    consumer_errors = 0;
+    retries = 0;
+    latency_count = 0;
+    memset(latency, 0, sizeof(latency));
+    bs->reset();
+    
+    ucnt_t ctxsw = currcore->kernel_stats.n_ctxswc;
+    rtcnt_t start = chSysGetRealtimeCounterX();
+    if (bs->superloop) {
+        // Стек потребителя свободен, суперцикл работает в нем
+        thread_t *loop = chThdCreateStatic(waConsumer, sizeof(waConsumer), NORMALPRIO - 1, Superloop, NULL);
+        chThdWait(loop);
+    } else {
+        thread_t *producer = chThdCreateStatic(waProducer, sizeof(waProducer), NORMALPRIO - 1, Producer, NULL);
+        thread_t *consumer = chThdCreateStatic(waConsumer, sizeof(waConsumer), NORMALPRIO - 1, Consumer, NULL);
+        chThdWait(producer);
+        chThdWait(consumer);
+    }
+    rtcnt_t elapsed = chSysGetRealtimeCounterX() - start;
+    ctxsw = currcore->kernel_stats.n_ctxswc - ctxsw;
+    
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    
+    // Задержки: среднее и перцентили по отсортированному массиву, только по
+    // элементам, пришедшим по порядку
+    size_t n = latency_count;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += latency[i];
+    }
+    qsort(latency, n, sizeof(latency[0]), compare_rtcnt);
+    
+    res->elapsed_us = elapsed;
+    res->rate = (uint32_t)(((uint64_t)BENCH_ITEMS * RT_FREQUENCY) / elapsed);
+    res->lat_mean = (n > 0U) ? (uint32_t)(sum / n) : 0U;
+    res->lat_p50 = (n > 0U) ? latency[n / 2U] : 0U;
+    res->lat_p99 = (n > 0U) ? latency[(n * 99U) / 100U] : 0U;
+    res->lat_max = (n > 0U) ? latency[n - 1U] : 0U;
+    res->ctxsw_x100 = (uint32_t)(((uint64_t)ctxsw * 100U) / BENCH_ITEMS);
+    res->retries = retries;
+    res->errors = consumer_errors;
+    
+    chprintf(serial, "%-10s %8d %10u %10u %6u %6u %6u %8u %3u.%02u %8u %6u\r\n",
+             bs->name, BENCH_ITEMS, res->elapsed_us, res->rate,
+             res->lat_mean, res->lat_p50, res->lat_p99, res->lat_max,
+             res->ctxsw_x100 / 100U, res->ctxsw_x100 % 100U, res->retries, res->errors);
+}
+
+// Тикет-бенчмарк: TICKET_THREADS потоков-пользователей по очереди пишут в
+// общий буфер и читают из него, как задачи LAB3_VARIANT3
+typedef struct {
+    const char *name;
+    void (*reset)(void);
+    msg_t (*write)(int value); // MSG_OK, MSG_TIMEOUT - занят, MSG_RESET - полон
+    msg_t (*read)(int *value); // MSG_OK, MSG_TIMEOUT - занят, MSG_RESET - пуст
+} TicketStrategy;
+
+// Работа с тикетом после операции (в LAB3_VARIANT3 - вывод в лог, уже после
+// освобождения блокировки). Квант времени отключен (CH_CFG_TIME_QUANTUM 0),
+// поэтому она моделируется уступкой процессора
+static void ticket_work(void) {
+    chThdYield();
+}
+
+// Кольцо под блокировкой читатели/писатель, как TicketBuffer в LAB3_VARIANT3:
+// блокировка ждется не дольше TICKET_LOCK_TIMEOUT, затем отказ "busy".
+// Работа - после освобождения блокировки, как и в лабе
+static int rw_data[BUFFER_SIZE];
+static ring_t rw_ring;
+static rwlock_t rw_lock;
+
+static void rw_reset(void) {
+    ring_init(&rw_ring, rw_data, sizeof(int), BUFFER_SIZE);
+    rwlock_init(&rw_lock);
+}
+
+static msg_t rw_write(int value) {
+    if (rwlock_write_lock_timeout(&rw_lock, TICKET_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
+    }
+    bool ok = ring_put(&rw_ring, &value);
+    rwlock_write_unlock(&rw_lock);
+    ticket_work();
+    return ok ? MSG_OK : MSG_RESET;
+}
+
+static msg_t rw_read(int *value) {
+    if (rwlock_write_lock_timeout(&rw_lock, TICKET_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
+    }
+    bool ok = ring_get(&rw_ring, value);
+    rwlock_write_unlock(&rw_lock);
+    ticket_work();
+    return ok ? MSG_OK : MSG_RESET;
+}
+
+// Lock-free MPMC очередь из mpmc.h
+static size_t mpmc_data[MPMC_STORAGE_WORDS(sizeof(int), BUFFER_SIZE)];
+static mpmc_t mpmc_queue;
+
+static void mpmc_reset(void) {
+    mpmc_init(&mpmc_queue, mpmc_data, sizeof(int), BUFFER_SIZE);
+}
+
+static msg_t mpmc_write(int value) {
+    bool ok = mpmc_put(&mpmc_queue, &value);
+    ticket_work();
+    return ok ? MSG_OK : MSG_RESET;
+}
+
+static msg_t mpmc_read(int *value) {
+    bool ok = mpmc_get(&mpmc_queue, value);
+    ticket_work();
+    return ok ? MSG_OK : MSG_RESET;
+}
+
+static const TicketStrategy ticket_strategies[] = {
+    {"rwlock", rw_reset,   rw_write,   rw_read},
+    {"mpmc",   mpmc_reset, mpmc_write, mpmc_read},
+};
+
+#define TICKET_STRATEGIES (sizeof(ticket_strategies) / sizeof(ticket_strategies[0]))
+
+// Результаты тикет-прогона для CSV
+typedef struct {
+    uint32_t elapsed_us;
+    uint32_t rate;
+    uint32_t busy;
+    uint32_t busy_pm; // Промилле
+    uint32_t rejected;
+} TicketResult;
+
+static TicketResult ticket_results[TICKET_STRATEGIES];
+
+static const TicketStrategy *ticket_current;
+static uint32_t ticket_busy;     // Отказы "буфер занят"
+static uint32_t ticket_rejected; // Отказы "буфер полон / пуст"
+
+// Поток-пользователь: чередует запись и чтение, уступая процессор после
+// каждой операции, чтобы потоки перемешивались
+static THD_WORKING_AREA(waTicket[TICKET_THREADS], 256);
+static THD_FUNCTION(Ticket, arg) {
+    int base = (int)(intptr_t)arg * TICKET_OPS;
+    
+    for (int i = 0; i < TICKET_OPS; i++) {
+        int value = base + i;
+        msg_t msg = ((i & 1) == 0) ? ticket_current->write(value)
+                                   : ticket_current->read(&value);
+        if (msg == MSG_TIMEOUT) {
+            ticket_busy++;
+        } else if (msg == MSG_RESET) {
+            ticket_rejected++;
+        }
+        chThdYield();
+    }
+}
+
+static void run_ticket_strategy(const TicketStrategy *ts, TicketResult *res) {
+    thread_t *threads[TICKET_THREADS];
+    
+    ticket_current = ts;
+    ticket_busy = 0;
+    ticket_rejected = 0;
+    ts->reset();
+    
+    rtcnt_t start = chSysGetRealtimeCounterX();
+    for (int i = 0; i < TICKET_THREADS; i++) {
+        threads[i] = chThdCreateStatic(waTicket[i], sizeof(waTicket[i]), NORMALPRIO - 1,
+                                       Ticket, (void *)(intptr_t)i);
+    }
+    for (int i = 0; i < TICKET_THREADS; i++) {
+        chThdWait(threads[i]);
+    }
+    rtcnt_t elapsed = chSysGetRealtimeCounterX() - start;
+    
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    uint32_t ops = TICKET_THREADS * TICKET_OPS;
+    uint32_t rate = (uint32_t)(((uint64_t)ops * RT_FREQUENCY) / elapsed);
+    res->elapsed_us = elapsed;
+    res->rate = rate;
+    res->busy = ticket_busy;
+    res->busy_pm = (uint32_t)(((uint64_t)ticket_busy * 1000U) / ops);
+    res->rejected = ticket_rejected;
+    chprintf(serial, "%-10s %8u %10u %10u %8u %3u.%u%% %8u\r\n",
+             ts->name, ops, elapsed, rate, res->busy, res->busy_pm / 10U, res->busy_pm % 10U,
+             res->rejected);
+}
+
+// Бенчмарк записей переменной длины через pipe_t, как в LAB3_VARIANT4:
+// писатель отправляет пачку из PIPE_BURST записей одной операцией, читатель
+// читает все, что есть в канале, и разбирает целые записи
+typedef struct {
+    const char *name;
+    size_t min_len; // Тело записи: min_len..max_len байт, не меньше 4 (номер)
+    size_t max_len;
+} PipeStrategy;
+
+static const PipeStrategy pipe_strategies[] = {
+    {"fixed-4",  4,  4},
+    {"fixed-64", 64, 64},
+    {"random",   4,  PIPE_RECORD_MAX},
+};
+
+#define PIPE_STRATEGIES (sizeof(pipe_strategies) / sizeof(pipe_strategies[0]))
+
+// Результаты прогона записей для CSV
+typedef struct {
+    uint32_t bytes;
+    uint32_t elapsed_us;
+    uint32_t rate;
+    uint32_t byte_rate;
+    uint32_t reads;
+    uint32_t per_read_x10; // Записей на чтение, x10
+    uint32_t errors;
+} PipeResult;
+
+static PipeResult pipe_results[PIPE_STRATEGIES];
+
+static uint8_t pipe_data[PIPE_SIZE];
+static pipe_t bench_pipe;
+static const PipeStrategy *pipe_current;
+static uint32_t pipe_bytes;
+static uint32_t pipe_reads;
+static uint32_t pipe_errors;
+static uint32_t pipe_expected;
+
+static THD_WORKING_AREA(waPipeWriter, 256);
+static THD_FUNCTION(PipeWriter, arg) {
+    (void)arg;
+    static uint8_t burst[PIPE_BURST * RECORD_SIZE(PIPE_RECORD_MAX)];
+    prng_t rng;
+    prng_seed(&rng, 12345U, 0);
+    
+    for (uint32_t seq = 0; seq < PIPE_RECORDS; ) {
+        size_t len = 0;
+        for (int i = 0; (i < PIPE_BURST) && (seq < PIPE_RECORDS); i++, seq++) {
+            size_t body_len = pipe_current->min_len +
+                prng_below(&rng, pipe_current->max_len - pipe_current->min_len + 1U);
+            uint8_t *body = record_start(&burst[len], body_len);
+            memcpy(body, &seq, sizeof(seq));
+            len += RECORD_SIZE(body_len);
+        }
+        (void)chPipeWriteTimeout(&bench_pipe, burst, len, TIME_INFINITE);
+        pipe_bytes += (uint32_t)len;
+    }
+}
+
+static void pipe_check_record(void *arg, const uint8_t *body, size_t len) {
+    uint32_t seq;
+    (void)arg;
+    
+    memcpy(&seq, body, sizeof(seq));
+    if ((len < pipe_current->min_len) || (len > pipe_current->max_len) ||
+        (seq != pipe_expected)) {
+        pipe_errors++;
+    }
+    pipe_expected = seq + 1U;
+}
+
+static THD_WORKING_AREA(waPipeReader, 256);
+static THD_FUNCTION(PipeReader, arg) {
+    (void)arg;
+    static uint8_t parse_data[PIPE_SIZE + RECORD_SIZE(PIPE_RECORD_MAX)];
+    record_parser_t parser;
+    record_parser_init(&parser, parse_data, sizeof(parse_data));
+    size_t records = 0;
+    
+    while (records < PIPE_RECORDS) {
+        size_t room;
+        uint8_t *dst = record_parser_space(&parser, &room);
+        // Ждем первый байт, остальное - сколько уже есть
+        size_t n = chPipeReadTimeout(&bench_pipe, dst, 1, TIME_INFINITE);
+        n += chPipeReadTimeout(&bench_pipe, &dst[n], room - n, TIME_IMMEDIATE);
+        records += record_parser_commit(&parser, n, pipe_check_record, NULL);
+        pipe_reads++;
+    }
+}
+
+static void run_pipe_strategy(const PipeStrategy *ps, PipeResult *res) {
+    pipe_current = ps;
+    pipe_bytes = 0;
+    pipe_reads = 0;
+    pipe_errors = 0;
+    pipe_expected = 0;
+    chPipeObjectInit(&bench_pipe, pipe_data, PIPE_SIZE);
+    
+    rtcnt_t start = chSysGetRealtimeCounterX();
+    thread_t *reader = chThdCreateStatic(waPipeReader, sizeof(waPipeReader),
+                                         NORMALPRIO - 1, PipeReader, NULL);
+    thread_t *writer = chThdCreateStatic(waPipeWriter, sizeof(waPipeWriter),
+                                         NORMALPRIO - 1, PipeWriter, NULL);
+    chThdWait(writer);
+    chThdWait(reader);
+    rtcnt_t elapsed = chSysGetRealtimeCounterX() - start;
+    
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    res->bytes = pipe_bytes;
+    res->elapsed_us = elapsed;
+    res->rate = (uint32_t)(((uint64_t)PIPE_RECORDS * RT_FREQUENCY) / elapsed);
+    res->byte_rate = (uint32_t)(((uint64_t)pipe_bytes * RT_FREQUENCY) / elapsed);
+    res->reads = pipe_reads;
+    res->per_read_x10 = (pipe_reads > 0U) ? (PIPE_RECORDS * 10U) / pipe_reads : 0U;
+    res->errors = pipe_errors;
+    chprintf(serial, "%-10s %8d %9u %10u %10u %10u %8u %4u.%u %6u\r\n",
+             ps->name, PIPE_RECORDS, res->bytes, res->elapsed_us, res->rate, res->byte_rate,
+             res->reads, res->per_read_x10 / 10U, res->per_read_x10 % 10U, res->errors);
+}
+
+// Бенчмарк размера сообщения, как LAB3_VARIANT2 с BUFFER_USE_OBJFIFO и без:
+// копирующее кольцо против objects_fifo_t с передачей указателя. В обоих
+// вариантах производитель заполняет, а потребитель читает сообщение целиком,
+// разница - только в двух копированиях кольца
+typedef struct {
+    const char *name;
+    void (*reset)(size_t size);
+    void (*send)(uint8_t value);    // Сообщение из байтов value
+    bool (*receive)(uint8_t value); // false - испорченное сообщение
+} MsgStrategy;
+
+static const size_t msg_sizes[] = {4, 64, 512, MSG_SIZE_MAX};
+
+static uint32_t msg_storage[BUFFER_SIZE * MSG_SIZE_MAX / sizeof(uint32_t)];
+static size_t msg_size;
+
+// Проверка всех байтов сообщения
+static bool msg_check(const uint8_t *msg, uint8_t value) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < msg_size; i++) {
+        diff |= msg[i] ^ value;
+    }
+    return diff == 0U;
+}
+
+// Кольцо с семафорами из bring.h: сообщение собирается в буфере
+// производителя и копируется в кольцо, потребитель копирует его обратно
+static bring_t msg_ring;
+static uint8_t msg_out[MSG_SIZE_MAX];
+static uint8_t msg_in[MSG_SIZE_MAX];
+
+static void msg_ring_reset(size_t size) {
+    bring_init(&msg_ring, msg_storage, size, BUFFER_SIZE);
+}
+
+static void msg_ring_send(uint8_t value) {
+    memset(msg_out, value, msg_size);
+    (void)bring_put(&msg_ring, msg_out, TIME_INFINITE);
+}
+
+static bool msg_ring_receive(uint8_t value) {
+    (void)bring_get(&msg_ring, msg_in, TIME_INFINITE);
+    return msg_check(msg_in, value);
+}
+
+// objects_fifo_t: сообщение заполняется прямо в объекте, читается на месте
+static objects_fifo_t msg_fifo;
+static msg_t msg_fifo_msgs[BUFFER_SIZE];
+
+static void msg_fifo_reset(size_t size) {
+    chFifoObjectInit(&msg_fifo, size, BUFFER_SIZE, msg_storage, msg_fifo_msgs);
+}
+
+static void msg_fifo_send(uint8_t value) {
+    uint8_t *msg = chFifoTakeObjectTimeout(&msg_fifo, TIME_INFINITE);
+    memset(msg, value, msg_size);
+    chFifoSendObject(&msg_fifo, msg);
+}
+
+static bool msg_fifo_receive(uint8_t value) {
+    void *objp;
+    (void)chFifoReceiveObjectTimeout(&msg_fifo, &objp, TIME_INFINITE);
+    bool ok = msg_check(objp, value);
+    chFifoReturnObject(&msg_fifo, objp);
+    return ok;
+}
+
+static const MsgStrategy msg_strategies[] = {
+    {"ring",    msg_ring_reset, msg_ring_send, msg_ring_receive},
+    {"objfifo", msg_fifo_reset, msg_fifo_send, msg_fifo_receive},
+};
+
+#define MSG_SIZES (sizeof(msg_sizes) / sizeof(msg_sizes[0]))
+#define MSG_STRATEGIES (sizeof(msg_strategies) / sizeof(msg_strategies[0]))
+
+// Результаты прогона размера сообщения для CSV
+typedef struct {
+    uint32_t elapsed_us;
+    uint32_t rate;
+    uint32_t kib_rate;
+    uint32_t errors;
+} MsgResult;
+
+static MsgResult msg_results[MSG_SIZES][MSG_STRATEGIES];
+
+static const MsgStrategy *msg_current;
+static uint32_t msg_errors;
+
+static THD_WORKING_AREA(waMsgWriter, 256);
+static THD_FUNCTION(MsgWriter, arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < MSG_ITEMS; i++) {
+        msg_current->send((uint8_t)i);
+    }
+}
+
+static THD_WORKING_AREA(waMsgReader, 256);
+static THD_FUNCTION(MsgReader, arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < MSG_ITEMS; i++) {
+        if (!msg_current->receive((uint8_t)i)) {
+            msg_errors++;
+        }
+    }
+}
+
+static void run_msg_strategy(const MsgStrategy *ms, size_t size, MsgResult *res) {
+    msg_current = ms;
+    msg_size = size;
+    msg_errors = 0;
+    ms->reset(size);
+    
+    rtcnt_t start = chSysGetRealtimeCounterX();
+    thread_t *reader = chThdCreateStatic(waMsgReader, sizeof(waMsgReader),
+                                         NORMALPRIO - 1, MsgReader, NULL);
+    thread_t *writer = chThdCreateStatic(waMsgWriter, sizeof(waMsgWriter),
+                                         NORMALPRIO - 1, MsgWriter, NULL);
+    chThdWait(writer);
+    chThdWait(reader);
+    rtcnt_t elapsed = chSysGetRealtimeCounterX() - start;
+    
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    res->elapsed_us = elapsed;
+    res->rate = (uint32_t)(((uint64_t)MSG_ITEMS * RT_FREQUENCY) / elapsed);
+    res->kib_rate = (uint32_t)(((uint64_t)MSG_ITEMS * size * RT_FREQUENCY) /
+                               ((uint64_t)elapsed * 1024U));
+    res->errors = msg_errors;
+    chprintf(serial, "%-10s %6u %8d %10u %10u %10u %6u\r\n",
+             ms->name, size, MSG_ITEMS, res->elapsed_us, res->rate, res->kib_rate, res->errors);
+}
+
+int main(void) {
+    halInit();
+    chSysInit();
+    sdStart(&SD1, NULL);
+    
+    chprintf(serial, "\r\n=== Buffer Throughput Benchmark ===\r\n");
+    chprintf(serial, "Buffer size: %d items, %d items per run, batch %d\r\n\r\n",
+             BUFFER_SIZE, BENCH_ITEMS, BENCH_BATCH);
+    chprintf(serial, "%-10s %8s %10s %10s %6s %6s %6s %8s %6s %8s %6s\r\n",
+             "strategy", "items", "us", "items/s", "mean", "p50", "p99", "max",
+             "csw", "retries", "errors");
+    
+    for (size_t i = 0; i < STRATEGIES; i++) {
+        run_strategy(&strategies[i], &results[i]);
+    }
+    
+    chprintf(serial, "\r\n=== Ticket Buffer Benchmark ===\r\n");
+    chprintf(serial, "%d user threads, %d write/read ops each\r\n\r\n",
+             TICKET_THREADS, TICKET_OPS);
+    chprintf(serial, "%-10s %8s %10s %10s %8s %6s %8s\r\n",
+             "strategy", "ops", "us", "ops/s", "busy", "busy%", "rejected");
+    
+    for (size_t i = 0; i < TICKET_STRATEGIES; i++) {
+        run_ticket_strategy(&ticket_strategies[i], &ticket_results[i]);
+    }
+    
+    chprintf(serial, "\r\n=== Pipe Record Benchmark ===\r\n");
+    chprintf(serial, "Pipe size: %d bytes, %d records per run, %d records per write\r\n\r\n",
+             PIPE_SIZE, PIPE_RECORDS, PIPE_BURST);
+    chprintf(serial, "%-10s %8s %9s %10s %10s %10s %8s %6s %6s\r\n",
+             "strategy", "records", "bytes", "us", "records/s", "bytes/s",
+             "reads", "rec/rd", "errors");
+    
+    for (size_t i = 0; i < PIPE_STRATEGIES; i++) {
+        run_pipe_strategy(&pipe_strategies[i], &pipe_results[i]);
+    }
+    
+    chprintf(serial, "\r\n=== Message Size Benchmark ===\r\n");
+    chprintf(serial, "Buffer size: %d messages, %d messages per run\r\n\r\n",
+             BUFFER_SIZE, MSG_ITEMS);
+    chprintf(serial, "%-10s %6s %8s %10s %10s %10s %6s\r\n",
+             "strategy", "size", "msgs", "us", "msgs/s", "KiB/s", "errors");
+    
+    for (size_t i = 0; i < MSG_SIZES; i++) {
+        for (size_t j = 0; j < MSG_STRATEGIES; j++) {
+            run_msg_strategy(&msg_strategies[j], msg_sizes[i], &msg_results[i][j]);
+        }
+    }
+    
+    // Итоговая таблица для обработки скриптами
+    chprintf(serial, "\r\n--- CSV ---\r\n");
+    chprintf(serial, "strategy,items,us,items_per_s,lat_mean_us,lat_p50_us,lat_p99_us,"
+                     "lat_max_us,ctxsw_per_item,retries,errors\r\n");
+    for (size_t i = 0; i < STRATEGIES; i++) {
+        const BenchResult *res = &results[i];
+        chprintf(serial, "%s,%d,%u,%u,%u,%u,%u,%u,%u.%02u,%u,%u\r\n",
+                 strategies[i].name, BENCH_ITEMS, res->elapsed_us, res->rate,
+                 res->lat_mean, res->lat_p50, res->lat_p99, res->lat_max,
+                 res->ctxsw_x100 / 100U, res->ctxsw_x100 % 100U, res->retries, res->errors);
+    }
+    chprintf(serial, "--- END ---\r\n");
+    
+    // Остальные таблицы - отдельными блоками со своими заголовками
+    chprintf(serial, "\r\n--- CSV ticket ---\r\n");
+    chprintf(serial, "strategy,ops,us,ops_per_s,busy,busy_pct,rejected\r\n");
+    for (size_t i = 0; i < TICKET_STRATEGIES; i++) {
+        const TicketResult *res = &ticket_results[i];
+        chprintf(serial, "%s,%d,%u,%u,%u,%u.%u,%u\r\n",
+                 ticket_strategies[i].name, TICKET_THREADS * TICKET_OPS, res->elapsed_us,
+                 res->rate, res->busy, res->busy_pm / 10U, res->busy_pm % 10U, res->rejected);
+    }
+    chprintf(serial, "--- END ---\r\n");
+    
+    chprintf(serial, "\r\n--- CSV pipe ---\r\n");
+    chprintf(serial, "strategy,records,bytes,us,records_per_s,bytes_per_s,reads,"
+                     "records_per_read,errors\r\n");
+    for (size_t i = 0; i < PIPE_STRATEGIES; i++) {
+        const PipeResult *res = &pipe_results[i];
+        chprintf(serial, "%s,%d,%u,%u,%u,%u,%u,%u.%u,%u\r\n",
+                 pipe_strategies[i].name, PIPE_RECORDS, res->bytes, res->elapsed_us,
+                 res->rate, res->byte_rate, res->reads,
+                 res->per_read_x10 / 10U, res->per_read_x10 % 10U, res->errors);
+    }
+    chprintf(serial, "--- END ---\r\n");
+    
+    chprintf(serial, "\r\n--- CSV message size ---\r\n");
+    chprintf(serial, "strategy,size,msgs,us,msgs_per_s,kib_per_s,errors\r\n");
+    for (size_t i = 0; i < MSG_SIZES; i++) {
+        for (size_t j = 0; j < MSG_STRATEGIES; j++) {
+            const MsgResult *res = &msg_results[i][j];
+            chprintf(serial, "%s,%u,%d,%u,%u,%u,%u\r\n",
+                     msg_strategies[j].name, msg_sizes[i], MSG_ITEMS, res->elapsed_us,
+                     res->rate, res->kib_rate, res->errors);
+        }
+    }
+    chprintf(serial, "--- END ---\r\n");
+    
+    chprintf(serial, "\r\nDone.\r\n");
+    
+    while (true) {
+        chThdSleepMilliseconds(1000);
+    }
+}
@@ -1,65 +1,70 @@
 #include "ch.h"
 #include "hal.h"
 #include "chprintf.h"
+#include "ring.h"
+#include "log.h"
+#include "dsched.h"
 
 static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
 
-#define BUFFER_SIZE 10
-static int buffer[BUFFER_SIZE];
-static size_t buffer_head = 0;
-static size_t buffer_tail = 0;
-static size_t buffer_count = 0;
+#define BUFFER_SIZE 16 // Степень двойки для ring.h
+static int buffer_data[BUFFER_SIZE];
+static ring_t buffer;
 
-// Таймеры для управления скоростью работы
-static systime_t last_producer_time = 0;
-static systime_t last_consumer_time = 0;
+// Скорости работы задач
 static size_t consumer_speed = 200;
 static size_t produser_speed = 800;
-static size_t default_timeout = 10;
 static int number_counter = 1;
 
+// Планировщик главного цикла: производитель и потребитель
+static dsched_task_t producer_task;
+static dsched_task_t consumer_task;
+static dsched_task_t *sched_heap[2];
+static dsched_t sched;
+
+static sysinterval_t producer(void *arg) {
+    (void)arg;
+    int num = number_counter;
+    if (ring_put(&buffer, &num)) {
+        number_counter++;
+        LOG_TRACE("[PRODUCER] Added: %3d (buffer: %2u/%d)\r\n", num, ring_count(&buffer), BUFFER_SIZE);
+    } else {
+        LOG_TRACE("[PRODUCER] Waiting (buffer full)\r\n");
+    }
+    return TIME_MS2I(consumer_speed);
+}
+
+static sysinterval_t consumer(void *arg) {
+    (void)arg;
+    int num;
+    if (ring_get(&buffer, &num)) {
+        LOG_TRACE("[CONSUMER] Processed: %3d (buffer: %2u/%d)\r\n", num, ring_count(&buffer), BUFFER_SIZE);
+    }
+    else
+    {
+        LOG_TRACE("[CONSUMER] Waiting (buffer empty)\r\n");
+    }
+    return TIME_MS2I(produser_speed);
+}
+
 int main(void) {
     halInit();
     chSysInit();
     sdStart(&SD1, NULL);
+    log_init(serial); // Вывод через отдельный поток
+    ring_init(&buffer, buffer_data, sizeof(int), BUFFER_SIZE);
     
-    chprintf(serial, "\r\n=== Producer-Consumer (Main Loop) ===\r\n");
-    chprintf(serial, "Producer: generates every %u ms\r\n", consumer_speed);
-    chprintf(serial, "Consumer: processes every %u ms\r\n", produser_speed);
-    chprintf(serial, "Buffer size: %d items\r\n\r\n", BUFFER_SIZE);
+    log_printf("\r\n=== Producer-Consumer (Main Loop) ===\r\n");
+    log_printf("Producer: generates every %u ms\r\n", consumer_speed);
+    log_printf("Consumer: processes every %u ms\r\n", produser_speed);
+    log_printf("Buffer size: %d items\r\n\r\n", BUFFER_SIZE);
+
+    dsched_init(&sched, sched_heap, 2);
+    dsched_add(&sched, &producer_task, producer, NULL, TIME_MS2I(consumer_speed));
+    dsched_add(&sched, &consumer_task, consumer, NULL, TIME_MS2I(produser_speed));
 
+    // Поток спит до ближайшего дедлайна вместо опроса каждые 10 мс
     while (true) {
-        systime_t now = chVTGetSystemTime();
-        
-        if (now - last_producer_time >= TIME_MS2I(consumer_speed)) {
-            if (buffer_count < BUFFER_SIZE) {
-                int num = number_counter++;
-                buffer[buffer_head] = num;
-                buffer_head = (buffer_head + 1) % BUFFER_SIZE;
-                buffer_count++;
-                
-                chprintf(serial, "[PRODUCER] Added: %3d (buffer: %2u/10)\r\n", num, buffer_count);
-            } else {
-                chprintf(serial, "[PRODUCER] Waiting (buffer full)\r\n");
-            }
-            last_producer_time = now;
-        }
-        
-        if (now - last_consumer_time >= TIME_MS2I(produser_speed)) {
-            if (buffer_count > 0) {
-                int num = buffer[buffer_tail];
-                buffer_tail = (buffer_tail + 1) % BUFFER_SIZE;
-                buffer_count--;
-                
-                chprintf(serial, "[CONSUMER] Processed: %3d (buffer: %2u/10)\r\n", num, buffer_count);
-            }
-            else
-            {
-                chprintf(serial, "[CONSUMER] Waiting (buffer empty)\r\n");
-            }
-            last_consumer_time = now;
-        }
-        
-        chThdSleepMilliseconds(default_timeout);
+        dsched_run_once(&sched);
     }
 }
\ No newline at end of file
@@ -1,124 +1,128 @@
 #include "ch.h"
 #include "hal.h"
 #include "chprintf.h"
+#include "ring.h"
+#include "log.h"
+#include "dsched.h"
 
 static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
 
-#define BUFFER_SIZE 10
+#define BUFFER_SIZE 16 // Степень двойки для ring.h
 
 // Первый кольцевой буфер
-static int buffer1[BUFFER_SIZE];
-static size_t buffer1_head = 0;
-static size_t buffer1_tail = 0;
-static size_t buffer1_count = 0;
+static int buffer1_data[BUFFER_SIZE];
+static ring_t buffer1;
 
 // Второй кольцевой буфер
-static int buffer2[BUFFER_SIZE];
-static size_t buffer2_head = 0;
-static size_t buffer2_tail = 0;
-static size_t buffer2_count = 0;
-
-// Таймеры для управления скоростью работы
-static systime_t last_task1_time = 0;
-static systime_t last_task2_time = 0;
-static systime_t last_monitor_time = 0;
+static int buffer2_data[BUFFER_SIZE];
+static ring_t buffer2;
 
 // Скорости работы задач
 static size_t task1_speed = 200;    // Запись в buffer1 и чтение из buffer2
 static size_t task2_speed = 300;    // Чтение из buffer1 и запись в buffer2
 static size_t monitor_speed = 1000; // Вывод состояния
-static size_t default_timeout = 10; // Таймаут основного цикла
 
 static int number_counter = 1;
 
+// Планировщик главного цикла: две задачи и монитор
+static dsched_task_t task1_entry;
+static dsched_task_t task2_entry;
+static dsched_task_t monitor_entry;
+static dsched_task_t *sched_heap[3];
+static dsched_t sched;
+
 // Функция для вывода состояния буфера
-static void print_buffer_state(const char* name, int* buffer, size_t head, size_t tail, size_t count) {
-    chprintf(serial, "%s: count=%2u, head=%2u, tail=%2u\r\n", name, count, head, tail);
-    chprintf(serial, "Contents: ");
+static void print_buffer_state(const char* name, ring_t *buffer) {
+    size_t count = ring_count(buffer);
+    log_printf("%s: count=%2u, head=%2u, tail=%2u\r\n", name, count,
+               ring_head_pos(buffer), ring_tail_pos(buffer));
     
+    // Строка содержимого собирается целиком и уходит в лог одной записью
+    char line[LOG_LINE_SIZE];
+    size_t len = (size_t)chsnprintf(line, sizeof(line), "Contents: ");
     if (count == 0) {
-        chprintf(serial, "empty");
+        chsnprintf(&line[len], sizeof(line) - len, "empty");
     } else {
-        size_t idx = tail;
-        for (size_t i = 0; i < count; i++) {
-            chprintf(serial, "%3d ", buffer[idx]);
-            idx = (idx + 1) % BUFFER_SIZE;
+        int num;
+        for (size_t i = 0; ring_peek(buffer, i, &num) && (len < sizeof(line)); i++) {
+            len += (size_t)chsnprintf(&line[len], sizeof(line) - len, "%3d ", num);
         }
     }
-    chprintf(serial, "\r\n");
+    log_printf("%s\r\n", line);
+}
+
+// Задача 1: запись в buffer1 и чтение из buffer2
+static sysinterval_t task1(void *arg) {
+    (void)arg;
+    // 1. Запись в buffer1
+    int num = number_counter;
+    if (ring_put(&buffer1, &num)) {
+        number_counter++;
+        LOG_TRACE("[TASK1] Added to buffer1: %3d (count: %2u/%d)\r\n", num, ring_count(&buffer1), BUFFER_SIZE);
+    } else {
+        LOG_TRACE("[TASK1] Buffer1 full, skipping write\r\n");
+    }
+    
+    // 2. Чтение из buffer2
+    if (ring_get(&buffer2, &num)) {
+        LOG_TRACE("[TASK1] Read from buffer2: %3d (count: %2u/%d)\r\n", num, ring_count(&buffer2), BUFFER_SIZE);
+    }
+    return TIME_MS2I(task1_speed);
+}
+
+// Задача 2: чтение из buffer1 и запись в buffer2
+static sysinterval_t task2(void *arg) {
+    (void)arg;
+    // 1. Чтение из buffer1
+    int num;
+    if (ring_get(&buffer1, &num)) {
+        LOG_TRACE("[TASK2] Read from buffer1: %3d (count: %2u/%d)\r\n", num, ring_count(&buffer1), BUFFER_SIZE);
+    }
+    
+    // 2. Запись в buffer2
+    num = number_counter;
+    if (ring_put(&buffer2, &num)) {
+        number_counter++;
+        LOG_TRACE("[TASK2] Added to buffer2: %3d (count: %2u/%d)\r\n", num, ring_count(&buffer2), BUFFER_SIZE);
+    } else {
+        LOG_TRACE("[TASK2] Buffer2 full, skipping write\r\n");
+    }
+    return TIME_MS2I(task2_speed);
+}
+
+// Мониторинг состояния буферов
+static sysinterval_t monitor(void *arg) {
+    (void)arg;
+    log_printf("\r\n=== Buffer Status ===\r\n");
+    print_buffer_state("Buffer1", &buffer1);
+    print_buffer_state("Buffer2", &buffer2);
+    log_printf("Scheduler: wakeups=%u, dispatched=%u\r\n",
+               sched.wakeups, sched.dispatched);
+    log_printf("====================\r\n\r\n");
+    return TIME_MS2I(monitor_speed);
 }
 
 int main(void) {
     halInit();
     chSysInit();
     sdStart(&SD1, NULL);
+    log_init(serial); // Вывод через отдельный поток
+    ring_init(&buffer1, buffer1_data, sizeof(int), BUFFER_SIZE);
+    ring_init(&buffer2, buffer2_data, sizeof(int), BUFFER_SIZE);
     
-    chprintf(serial, "\r\n=== Dual Ring Buffer (Main Loop) ===\r\n");
-    chprintf(serial, "Task1: writes to buffer1, reads from buffer2 every %u ms\r\n", task1_speed);
-    chprintf(serial, "Task2: reads from buffer1, writes to buffer2 every %u ms\r\n", task2_speed);
-    chprintf(serial, "Monitor: prints status every %u ms\r\n", monitor_speed);
-    chprintf(serial, "Buffer size: %d items each\r\n\r\n", BUFFER_SIZE);
+    log_printf("\r\n=== Dual Ring Buffer (Main Loop) ===\r\n");
+    log_printf("Task1: writes to buffer1, reads from buffer2 every %u ms\r\n", task1_speed);
+    log_printf("Task2: reads from buffer1, writes to buffer2 every %u ms\r\n", task2_speed);
+    log_printf("Monitor: prints status every %u ms\r\n", monitor_speed);
+    log_printf("Buffer size: %d items each\r\n\r\n", BUFFER_SIZE);
+
+    dsched_init(&sched, sched_heap, 3);
+    dsched_add(&sched, &task1_entry, task1, NULL, TIME_MS2I(task1_speed));
+    dsched_add(&sched, &task2_entry, task2, NULL, TIME_MS2I(task2_speed));
+    dsched_add(&sched, &monitor_entry, monitor, NULL, TIME_MS2I(monitor_speed));
 
+    // Поток спит до ближайшего дедлайна вместо опроса каждые 10 мс
     while (true) {
-        systime_t now = chVTGetSystemTime();
-        
-        // Задача 1: запись в buffer1 и чтение из buffer2
-        if (now - last_task1_time >= TIME_MS2I(task1_speed)) {
-            // 1. Запись в buffer1
-            if (buffer1_count < BUFFER_SIZE) {
-                int num = number_counter++;
-                buffer1[buffer1_head] = num;
-                buffer1_head = (buffer1_head + 1) % BUFFER_SIZE;
-                buffer1_count++;
-                chprintf(serial, "[TASK1] Added to buffer1: %3d (count: %2u/10)\r\n", num, buffer1_count);
-            } else {
-                chprintf(serial, "[TASK1] Buffer1 full, skipping write\r\n");
-            }
-            
-            // 2. Чтение из buffer2
-            if (buffer2_count > 0) {
-                int num = buffer2[buffer2_tail];
-                buffer2_tail = (buffer2_tail + 1) % BUFFER_SIZE;
-                buffer2_count--;
-                chprintf(serial, "[TASK1] Read from buffer2: %3d (count: %2u/10)\r\n", num, buffer2_count);
-            }
-            
-            last_task1_time = now;
-        }
-        
-        // Задача 2: чтение из buffer1 и запись в buffer2
-        if (now - last_task2_time >= TIME_MS2I(task2_speed)) {
-            // 1. Чтение из buffer1
-            if (buffer1_count > 0) {
-                int num = buffer1[buffer1_tail];
-                buffer1_tail = (buffer1_tail + 1) % BUFFER_SIZE;
-                buffer1_count--;
-                chprintf(serial, "[TASK2] Read from buffer1: %3d (count: %2u/10)\r\n", num, buffer1_count);
-            }
-            
-            // 2. Запись в buffer2
-            if (buffer2_count < BUFFER_SIZE) {
-                int num = number_counter++;
-                buffer2[buffer2_head] = num;
-                buffer2_head = (buffer2_head + 1) % BUFFER_SIZE;
-                buffer2_count++;
-                chprintf(serial, "[TASK2] Added to buffer2: %3d (count: %2u/10)\r\n", num, buffer2_count);
-            } else {
-                chprintf(serial, "[TASK2] Buffer2 full, skipping write\r\n");
-            }
-            
-            last_task2_time = now;
-        }
-        
-        // Мониторинг состояния буферов
-        if (now - last_monitor_time >= TIME_MS2I(monitor_speed)) {
-            chprintf(serial, "\r\n=== Buffer Status ===\r\n");
-            print_buffer_state("Buffer1", buffer1, buffer1_head, buffer1_tail, buffer1_count);
-            print_buffer_state("Buffer2", buffer2, buffer2_head, buffer2_tail, buffer2_count);
-            chprintf(serial, "====================\r\n\r\n");
-            last_monitor_time = now;
-        }
-        
-        chThdSleepMilliseconds(default_timeout);
+        dsched_run_once(&sched);
     }
 }
\ No newline at end of file
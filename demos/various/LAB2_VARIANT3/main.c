@@ -1,146 +1,235 @@
 #include "ch.h"
 #include "hal.h"
 #include "chprintf.h"
-#include <stdlib.h>
+#include "ring.h"
+#include "log.h"
+#include "prng.h"
+#include "rwlock.h"
+#include "dsched.h"
 
 static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
 
-#define BUFFER_SIZE 10
+#define BUFFER_SIZE 16 // Степень двойки для ring.h
 #define USER_TASKS 10
+#if !defined(TICKET_BUFFERS)
+#define TICKET_BUFFERS 2      // Число буферов (шардов) хранилища
+#endif
 #define MONITOR_INTERVAL 1000 // 1 second
+#if !defined(RANDOM_SEED)
+#define RANDOM_SEED 12345     // Общий seed генераторов задач: тот же seed - тот же прогон
+#endif
+#define BUFFER_LOCK_TIMEOUT TIME_MS2I(5) // Дольше ждать блокировку - буфер "занят"
 
 // Структура для буфера
 typedef struct {
     int data[BUFFER_SIZE];
-    size_t head;
-    size_t tail;
-    size_t count;
-    int readers;
-    int writers;
+    ring_t ring;
+    rwlock_t lock; // Просмотр - общий доступ, изменение - монопольный
 } TicketBuffer;
 
 // Структура для пользовательской задачи
 typedef struct {
-    systime_t last_run;
-    systime_t interval;
+    dsched_task_t entry; // Дедлайн задачи в планировщике
     int task_num;
+    prng_t rng;          // Собственный генератор задачи
 } UserTask;
 
-// Два буфера
-static TicketBuffer buffer1, buffer2;
+// Хранилище тикетов: TICKET_BUFFERS буферов-шардов. У каждой задачи свой
+// домашний шард, чтение из пустого шарда крадет тикет у соседей
+static TicketBuffer buffers[TICKET_BUFFERS];
+
+// Счетчики шардов для монитора
+typedef struct {
+    uint32_t writes; // Успешных записей
+    uint32_t reads;  // Успешных чтений, включая украденные
+    uint32_t steals; // Чтений, выполненных вместо пустого соседа
+    uint32_t fails;  // Отказов: полон / пуст / занят
+} ShardStats;
+
+static ShardStats shard_stats[TICKET_BUFFERS];
 
 // Пользовательские задачи
 static UserTask user_tasks[USER_TASKS];
 
+// Планировщик главного цикла: пользовательские задачи и монитор
+static dsched_task_t monitor_entry;
+static dsched_task_t *sched_heap[USER_TASKS + 1];
+static dsched_t sched;
+
 // Инициализация буфера
 static void buffer_init(TicketBuffer *buf) {
-    buf->head = 0;
-    buf->tail = 0;
-    buf->count = 0;
-    buf->readers = 0;
-    buf->writers = 0;
+    ring_init(&buf->ring, buf->data, sizeof(int), BUFFER_SIZE);
+    rwlock_init(&buf->lock);
 }
 
-// Попытка чтения из буфера
-static bool buffer_read(TicketBuffer *buf, int *value) {
-    if (buf->writers > 0) {
-        return false; // Есть писатель - чтение невозможно
-    }
-    
-    if (buf->count == 0) {
-        return false; // Буфер пуст
+// Результат операций с буфером: MSG_OK - выполнено, MSG_TIMEOUT - буфер
+// занят дольше BUFFER_LOCK_TIMEOUT, MSG_RESET - буфер пуст / полон
+
+// Чтение из буфера: извлечение сдвигает tail, поэтому доступ монопольный
+static msg_t buffer_read(TicketBuffer *buf, int *value) {
+    if (rwlock_write_lock_timeout(&buf->lock, BUFFER_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
     }
     
-    buf->readers++;
-    *value = buf->data[buf->tail];
-    buf->tail = (buf->tail + 1) % BUFFER_SIZE;
-    buf->count--;
-    buf->readers--;
+    bool ok = ring_get(&buf->ring, value);
+    rwlock_write_unlock(&buf->lock);
     
-    return true;
+    return ok ? MSG_OK : MSG_RESET;
 }
 
-// Попытка записи в буфер
-static bool buffer_write(TicketBuffer *buf, int value) {
-    if (buf->readers > 0 || buf->writers > 0) {
-        return false; // Есть читатели или писатели - запись невозможна
+// Просмотр первого элемента без извлечения: читатели работают параллельно
+static msg_t buffer_peek(TicketBuffer *buf, int *value) {
+    if (rwlock_read_lock_timeout(&buf->lock, BUFFER_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
     }
     
-    if (buf->count == BUFFER_SIZE) {
-        return false; // Буфер полон
+    bool ok = ring_peek(&buf->ring, 0, value);
+    rwlock_read_unlock(&buf->lock);
+    
+    return ok ? MSG_OK : MSG_RESET;
+}
+
+// Запись в буфер, монопольный доступ
+static msg_t buffer_write(TicketBuffer *buf, int value) {
+    if (rwlock_write_lock_timeout(&buf->lock, BUFFER_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
     }
     
-    buf->writers++;
-    buf->data[buf->head] = value;
-    buf->head = (buf->head + 1) % BUFFER_SIZE;
-    buf->count++;
-    buf->writers--;
+    bool ok = ring_put(&buf->ring, &value);
+    rwlock_write_unlock(&buf->lock);
     
-    return true;
+    return ok ? MSG_OK : MSG_RESET;
 }
 
 // Вывод состояния буфера
 static void buffer_print(TicketBuffer *buf, const char *name) {
-    chprintf(serial, "%s: count=%2u, head=%2u, tail=%2u\r\n", 
-             name, buf->count, buf->head, buf->tail);
-    chprintf(serial, "Contents: ");
+    // Снимок под общей блокировкой, вывод - уже после ее освобождения
+    rwlock_read_lock(&buf->lock);
+    size_t count = ring_count(&buf->ring);
+    size_t head = ring_head_pos(&buf->ring);
+    size_t tail = ring_tail_pos(&buf->ring);
     
-    if (buf->count == 0) {
-        chprintf(serial, "empty");
+    // Строка содержимого собирается целиком и уходит в лог одной записью
+    char line[LOG_LINE_SIZE];
+    size_t len = (size_t)chsnprintf(line, sizeof(line), "Contents: ");
+    if (count == 0) {
+        chsnprintf(&line[len], sizeof(line) - len, "empty");
     } else {
-        size_t idx = buf->tail;
-        for (size_t i = 0; i < buf->count; i++) {
-            chprintf(serial, "%3d ", buf->data[idx]);
-            idx = (idx + 1) % BUFFER_SIZE;
+        int value;
+        for (size_t i = 0; ring_peek(&buf->ring, i, &value) && (len < sizeof(line)); i++) {
+            len += (size_t)chsnprintf(&line[len], sizeof(line) - len, "%3d ", value);
         }
     }
-    chprintf(serial, "\r\n");
+    rwlock_read_unlock(&buf->lock);
+    
+    log_printf("%s: count=%2u, head=%2u, tail=%2u\r\n", name, count, head, tail);
+    log_printf("%s\r\n", line);
 }
 
-// Инициализация пользовательских задач
-static void init_user_tasks(void) {
-    for (int i = 0; i < USER_TASKS; i++) {
-        user_tasks[i].task_num = i + 1;
-        user_tasks[i].interval = 100 + rand() % 400; // Случайный интервал 100-500 мс
-        user_tasks[i].last_run = 0;
-    }
+// Домашний шард задачи: стабильный (мультипликативный) хеш ее номера,
+// задачи расходятся по шардам равномерно при любом TICKET_BUFFERS
+static size_t home_shard(const UserTask *task) {
+    return ((uint32_t)task->task_num * 2654435761U) % TICKET_BUFFERS;
 }
 
 // Обработка одной пользовательской задачи
-static void process_user_task(UserTask *task) {
-    systime_t now = chVTGetSystemTime();
+static sysinterval_t process_user_task(void *arg) {
+    UserTask *task = (UserTask *)arg;
+    
+    // Задача работает со своим домашним шардом
+    size_t index = home_shard(task);
+    TicketBuffer *buf = &buffers[index];
+    int buf_num = (int)index + 1;
     
-    if (now - task->last_run >= TIME_MS2I(task->interval)) {
-        // Случайный выбор буфера (1 или 2)
-        TicketBuffer *buf = (rand() % 2) ? &buffer1 : &buffer2;
-        const char *buf_name = (buf == &buffer1) ? "Buffer1" : "Buffer2";
-        
-        // Случайное действие (чтение или запись)
-        if (rand() % 2) {
-            // Запись
-            static int counter = 1;
-            int value = counter++;
-            if (buffer_write(buf, value)) {
-                chprintf(serial, "[Task %d] Wrote to %s: %d\r\n", 
-                         task->task_num, buf_name, value);
-            } else {
-                chprintf(serial, "[Task %d] %s is busy or full\r\n", 
-                         task->task_num, buf_name);
+    // Случайное действие: запись, чтение или просмотр
+    int value;
+    msg_t msg;
+    int action = (int)prng_below(&task->rng, 3);
+    if (action == 0) {
+        // Запись
+        static int counter = 1;
+        value = counter++;
+        msg = buffer_write(buf, value);
+        if (msg == MSG_OK) {
+            shard_stats[index].writes++;
+            LOG_TRACE("[Task %d] Wrote to Buffer%d: %d\r\n", 
+                      task->task_num, buf_num, value);
+        } else if (msg == MSG_RESET) {
+            LOG_TRACE("[Task %d] Buffer%d is full\r\n", 
+                      task->task_num, buf_num);
+        }
+    } else if (action == 1) {
+        // Чтение
+        msg = buffer_read(buf, &value);
+        if (msg == MSG_OK) {
+            shard_stats[index].reads++;
+            LOG_TRACE("[Task %d] Read from Buffer%d: %d\r\n", 
+                      task->task_num, buf_num, value);
+        } else if (msg == MSG_RESET) {
+            // Домашний шард пуст - крадем у соседей по кругу
+            for (size_t i = 1; (msg == MSG_RESET) && (i < TICKET_BUFFERS); i++) {
+                size_t victim = (index + i) % TICKET_BUFFERS;
+                if (buffer_read(&buffers[victim], &value) == MSG_OK) {
+                    msg = MSG_OK;
+                    shard_stats[victim].reads++;
+                    shard_stats[victim].steals++;
+                    LOG_TRACE("[Task %d] Stole from Buffer%d: %d\r\n", 
+                              task->task_num, (int)victim + 1, value);
+                }
             }
-        } else {
-            // Чтение
-            int value;
-            if (buffer_read(buf, &value)) {
-                chprintf(serial, "[Task %d] Read from %s: %d\r\n", 
-                         task->task_num, buf_name, value);
-            } else {
-                chprintf(serial, "[Task %d] %s is busy or empty\r\n", 
-                         task->task_num, buf_name);
+            if (msg == MSG_RESET) {
+                LOG_TRACE("[Task %d] Buffer%d is empty\r\n", 
+                          task->task_num, buf_num);
             }
         }
-        
-        task->last_run = now;
-        task->interval = 100 + rand() % 400; // Новый случайный интервал
+    } else {
+        // Просмотр
+        msg = buffer_peek(buf, &value);
+        if (msg == MSG_OK) {
+            LOG_TRACE("[Task %d] Peeked Buffer%d: %d\r\n", 
+                      task->task_num, buf_num, value);
+        } else if (msg == MSG_RESET) {
+            LOG_TRACE("[Task %d] Buffer%d is empty\r\n", 
+                      task->task_num, buf_num);
+        }
+    }
+    if (msg == MSG_TIMEOUT) {
+        LOG_TRACE("[Task %d] Buffer%d is busy\r\n", task->task_num, buf_num);
+    }
+    if (msg != MSG_OK) {
+        shard_stats[index].fails++;
+    }
+    
+    return TIME_MS2I(100 + prng_below(&task->rng, 400)); // Новый случайный интервал
+}
+
+// Периодический вывод состояния буферов
+static sysinterval_t monitor(void *arg) {
+    (void)arg;
+    log_printf("\r\n=== Buffer Status ===\r\n");
+    for (int i = 0; i < TICKET_BUFFERS; i++) {
+        char name[16];
+        chsnprintf(name, sizeof(name), "Buffer%d", i + 1);
+        buffer_print(&buffers[i], name);
+        ShardStats *st = &shard_stats[i];
+        log_printf("  writes=%u, reads=%u, steals=%u, fails=%u\r\n",
+                   st->writes, st->reads, st->steals, st->fails);
+    }
+    log_printf("Scheduler: wakeups=%u, dispatched=%u\r\n",
+               sched.wakeups, sched.dispatched);
+    log_printf("====================\r\n\r\n");
+    return TIME_MS2I(MONITOR_INTERVAL);
+}
+
+// Инициализация пользовательских задач
+static void init_user_tasks(void) {
+    for (int i = 0; i < USER_TASKS; i++) {
+        UserTask *task = &user_tasks[i];
+        task->task_num = i + 1;
+        prng_seed(&task->rng, RANDOM_SEED, (uint32_t)task->task_num);
+        // Случайный интервал 100-500 мс до первого запуска
+        dsched_add(&sched, &task->entry, process_user_task, task,
+                   TIME_MS2I(100 + prng_below(&task->rng, 400)));
     }
 }
 
@@ -148,37 +237,23 @@ int main(void) {
     halInit();
     chSysInit();
     sdStart(&SD1, NULL);
+    log_init(serial); // Вывод через отдельный поток
     
     // Инициализация буферов
-    buffer_init(&buffer1);
-    buffer_init(&buffer2);
+    for (int i = 0; i < TICKET_BUFFERS; i++) {
+        buffer_init(&buffers[i]);
+    }
     
-    // Инициализация пользовательских задач
+    // Инициализация планировщика и пользовательских задач
+    dsched_init(&sched, sched_heap, USER_TASKS + 1);
     init_user_tasks();
+    dsched_add(&sched, &monitor_entry, monitor, NULL, TIME_MS2I(MONITOR_INTERVAL));
     
-    chprintf(serial, "\r\n=== Ticket System with Two Buffers ===\r\n");
-    chprintf(serial, "Running %d user tasks in main loop...\r\n\r\n", USER_TASKS);
-    
-    systime_t last_monitor_time = 0;
+    log_printf("\r\n=== Ticket System with %d Buffers ===\r\n", TICKET_BUFFERS);
+    log_printf("Running %d user tasks in main loop...\r\n\r\n", USER_TASKS);
     
+    // Поток спит до ближайшего дедлайна вместо опроса каждые 10 мс
     while (true) {
-        systime_t now = chVTGetSystemTime();
-        
-        // Обработка всех пользовательских задач
-        for (int i = 0; i < USER_TASKS; i++) {
-            process_user_task(&user_tasks[i]);
-        }
-        
-        // Периодический вывод состояния буферов
-        if (now - last_monitor_time >= TIME_MS2I(MONITOR_INTERVAL)) {
-            chprintf(serial, "\r\n=== Buffer Status ===\r\n");
-            buffer_print(&buffer1, "Buffer1");
-            buffer_print(&buffer2, "Buffer2");
-            chprintf(serial, "====================\r\n\r\n");
-            last_monitor_time = now;
-        }
-        
-        // Небольшая задержка для уменьшения нагрузки на CPU
-        chThdSleepMilliseconds(10);
+        dsched_run_once(&sched);
     }
 }
\ No newline at end of file
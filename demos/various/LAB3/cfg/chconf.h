@@ -619,7 +619,7 @@
  * @note    The default is @p CH_DBG_TRACE_MASK_DISABLED.
  */
 #if !defined(CH_DBG_TRACE_MASK)
-#define CH_DBG_TRACE_MASK                   CH_DBG_TRACE_MASK_DISABLED
+#define CH_DBG_TRACE_MASK                   CH_DBG_TRACE_MASK_ALL
 #endif
 
 /**
@@ -810,6 +810,7 @@
  */
 #define CH_CFG_SYSTEM_HALT_HOOK(reason) {                                   \
   /* System halt code here.*/                                               \
+  ctrace_halt();                                                            \
 }
 
 /**
@@ -819,6 +820,8 @@
  */
 #define CH_CFG_TRACE_HOOK(tep) {                                            \
   /* Trace code here.*/                                                     \
+  ctrace_record((tep)->type, (tep)->state,                                  \
+                (tep)->u.user.up1, (tep)->u.user.up2);                      \
 }
 
 /**
@@ -831,6 +834,19 @@
 
 /** @} */
 
+/*===========================================================================*/
+/* Lab instrumentation (common/ctrace.c).                                    */
+/*===========================================================================*/
+
+/* Chrome trace-event export of the kernel trace, called from the hooks
+   above.*/
+#define CTRACE_ENABLED                      TRUE
+
+#if !defined(_FROM_ASM_)
+void ctrace_record(unsigned type, unsigned state, void *p1, void *p2);
+void ctrace_halt(void);
+#endif
+
 /*===========================================================================*/
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
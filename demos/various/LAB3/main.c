@@ -2,52 +2,129 @@
 #include "hal.h"
 #include "chprintf.h"
 #include "chmtx.h"
-#include "chevents.h"
+#include "bring.h"
+#include "log.h"
+#include "lathist.h"
+#include "ctrace.h"
 
 static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
 
-#define BUFFER_SIZE 10
-static int buffer[BUFFER_SIZE];
-static size_t buffer_head = 0;
-static size_t buffer_tail = 0;
-static size_t buffer_count = 0;
+#define BUFFER_SIZE 16 // Степень двойки для ring.h
+
+// Метка времени постановки в очередь у каждого элемента: потребитель
+// собирает гистограмму задержки в очереди, монитор ее печатает
+#if !defined(ITEM_TIMESTAMPS)
+#define ITEM_TIMESTAMPS TRUE
+#endif
+
+// Вариант передачи: FALSE - кольцо bring_t, TRUE - указатели на элементы
+// из пула через почтовый ящик ChibiOS (для сравнения, BENCH строка mailbox)
+#if !defined(BUFFER_USE_MAILBOX)
+#define BUFFER_USE_MAILBOX FALSE
+#endif
+
+#define MONITOR_INTERVAL 5000 // Период вывода гистограммы, мс
+
+typedef struct {
+    int value;
+#if ITEM_TIMESTAMPS
+    rtcnt_t stamp; // chSysGetRealtimeCounterX() в момент записи
+#endif
+} Item;
+
+#if BUFFER_USE_MAILBOX
+// Элементы берутся из пула с семафором: пустой пул блокирует производителя,
+// как полный буфер. Объектов столько же, сколько мест в ящике, поэтому
+// отправка в ящик не блокируется никогда
+static Item item_objects[BUFFER_SIZE];
+static guarded_memory_pool_t item_pool;
+static msg_t mailbox_data[BUFFER_SIZE];
+static mailbox_t mailbox;
+#else
+// Один производитель и один потребитель - мьютекс буферу не нужен,
+// ожидание свободного/заполненного слота - на семафорах bring_t
+static Item buffer_data[BUFFER_SIZE];
+static bring_t buffer;
+#endif
 static size_t consumer_speed = 200;
 static size_t produser_speed = 800;
-static mutex_t buffer_mutex;
-static mutex_t print_mutex;  // Отдельный мьютекс для вывода
-static event_source_t buffer_event;
+#define PRODUCER_BURST 4  // Элементов, производимых за один период
+#define CONSUMER_BATCH 8  // Максимум элементов, обрабатываемых одним участком кольца
 
 static int number_counter = 1;
 
+#if ITEM_TIMESTAMPS
+static lathist_t latency; // Пишет только потребитель
+#endif
+
+// Заполненность буфера для вывода
+static size_t buffer_count(void) {
+#if BUFFER_USE_MAILBOX
+    chSysLock();
+    size_t count = chMBGetUsedCountI(&mailbox);
+    chSysUnlock();
+    return count;
+#else
+    return bring_count(&buffer);
+#endif
+}
+
 static THD_WORKING_AREA(waProducer, 256);
 static THD_FUNCTION(Producer, arg) {
     (void)arg;
+    chRegSetThreadName("Producer");
     
     while (true) {
-        int num = number_counter++;
+        int first = number_counter;
+        size_t added = 0;
         
-        chMtxLock(&buffer_mutex);
-        while (buffer_count == BUFFER_SIZE) {
-            chMtxUnlock(&buffer_mutex);
+#if BUFFER_USE_MAILBOX
+        // Каждый элемент - объект из пула, в ящик уходит указатель на него
+        while (added < PRODUCER_BURST) {
+            Item *item = chGuardedPoolAllocTimeout(&item_pool, TIME_IMMEDIATE);
+            if (item == NULL) {
+                LOG_TRACE("[PRODUCER] Waiting (buffer full)\r\n");
+                
+                // Просыпаемся, как только потребитель вернет объект в пул
+                item = chGuardedPoolAllocTimeout(&item_pool, TIME_INFINITE);
+            }
             
-            chMtxLock(&print_mutex);
-            chprintf(serial, "[PRODUCER] Waiting (buffer full)\r\n");
-            chMtxUnlock(&print_mutex);
+            item->value = number_counter++;
+#if ITEM_TIMESTAMPS
+            item->stamp = chSysGetRealtimeCounterX();
+#endif
+            (void)chMBPostTimeout(&mailbox, (msg_t)item, TIME_INFINITE);
+            added++;
+        }
+#else
+        // Пачка пишется прямо в слоты кольца, без промежуточной копии
+        while (added < PRODUCER_BURST) {
+            size_t n = PRODUCER_BURST - added;
+            Item *slots = bring_reserve(&buffer, &n, TIME_IMMEDIATE);
+            if (slots == NULL) {
+                LOG_TRACE("[PRODUCER] Waiting (buffer full)\r\n");
+                
+                // Просыпаемся, как только потребитель освободит слот
+                n = PRODUCER_BURST - added;
+                slots = bring_reserve(&buffer, &n, TIME_INFINITE);
+            }
             
-            chThdSleepMilliseconds(produser_speed);
-            chMtxLock(&buffer_mutex);
+#if ITEM_TIMESTAMPS
+            rtcnt_t now = chSysGetRealtimeCounterX();
+#endif
+            for (size_t i = 0; i < n; i++) {
+                slots[i].value = number_counter++;
+#if ITEM_TIMESTAMPS
+                slots[i].stamp = now;
+#endif
+            }
+            bring_commit(&buffer, n);
+            added += n;
         }
+#endif
         
-        buffer[buffer_head] = num;
-        buffer_head = (buffer_head + 1) % BUFFER_SIZE;
-        buffer_count++;
-        
-        chMtxLock(&print_mutex);
-        chprintf(serial, "[PRODUCER] Added: %3d (buffer: %2u/10)\r\n", num, buffer_count);
-        chMtxUnlock(&print_mutex);
-        
-        chEvtBroadcast(&buffer_event);
-        chMtxUnlock(&buffer_mutex);
+        LOG_TRACE("[PRODUCER] Added: %3d..%3d (buffer: %2u/%d)\r\n",
+                  first, number_counter - 1, buffer_count(), BUFFER_SIZE);
         
         chThdSleepMilliseconds(produser_speed);
     }
@@ -56,23 +133,68 @@ static THD_FUNCTION(Producer, arg) {
 static THD_WORKING_AREA(waConsumer, 256);
 static THD_FUNCTION(Consumer, arg) {
     (void)arg;
-    event_listener_t el;
-    chEvtRegister(&buffer_event, &el, 0);
+    chRegSetThreadName("Consumer");
     
     while (true) {
-        chEvtWaitAny(EVENT_MASK(0));
-        
-        chMtxLock(&buffer_mutex);
-        if (buffer_count > 0) {
-            int num = buffer[buffer_tail];
-            buffer_tail = (buffer_tail + 1) % BUFFER_SIZE;
-            buffer_count--;
+#if BUFFER_USE_MAILBOX
+        // Ожидание в ящике - только при действительно пустом ящике;
+        // проснувшись, потребитель забирает все накопившееся, выводя
+        // по строке на каждые CONSUMER_BATCH элементов
+        sysinterval_t timeout = TIME_INFINITE;
+        size_t count;
+        do {
+            int first = 0, last = 0;
+            msg_t msg;
+            
+            for (count = 0; count < CONSUMER_BATCH; count++) {
+                if (chMBFetchTimeout(&mailbox, &msg, timeout) != MSG_OK) {
+                    break;
+                }
+                Item *item = (Item *)msg;
+                if (count == 0) {
+                    first = item->value;
+                }
+                last = item->value;
+#if ITEM_TIMESTAMPS
+                // Задержка в очереди: от записи производителем до обработки
+                lathist_add(&latency, chSysGetRealtimeCounterX() - item->stamp);
+#endif
+                chGuardedPoolFree(&item_pool, item);
+                timeout = TIME_IMMEDIATE;
+            }
             
-            chMtxLock(&print_mutex);
-            chprintf(serial, "[CONSUMER] Processed: %3d (buffer: %2u/10)\r\n", num, buffer_count);
-            chMtxUnlock(&print_mutex);
+            if (count > 0) {
+                LOG_TRACE("[CONSUMER] Processed: %3d..%3d (buffer: %2u/%d)\r\n",
+                          first, last, buffer_count(), BUFFER_SIZE);
+            }
+        } while (count == CONSUMER_BATCH);
+#else
+        // Блокировка на семафоре filled - только при действительно пустом
+        // кольце, без потерянных пробуждений. Проснувшись, потребитель
+        // забирает все накопившееся участками до CONSUMER_BATCH прямо в
+        // кольце, а не одну пачку за период
+        sysinterval_t timeout = TIME_INFINITE;
+        size_t count = CONSUMER_BATCH;
+        const Item *items;
+        while ((items = bring_peek(&buffer, &count, timeout)) != NULL) {
+            int first = items[0].value;
+            int last = items[count - 1].value;
+#if ITEM_TIMESTAMPS
+            // Задержка в очереди: от записи производителем до обработки
+            rtcnt_t now = chSysGetRealtimeCounterX();
+            for (size_t i = 0; i < count; i++) {
+                lathist_add(&latency, now - items[i].stamp);
+            }
+#endif
+            bring_release(&buffer, count);
+            
+            LOG_TRACE("[CONSUMER] Processed: %3d..%3d (buffer: %2u/%d)\r\n",
+                      first, last, buffer_count(), BUFFER_SIZE);
+            
+            timeout = TIME_IMMEDIATE;
+            count = CONSUMER_BATCH;
         }
-        chMtxUnlock(&buffer_mutex);
+#endif
         
         chThdSleepMilliseconds(consumer_speed);
     }
@@ -82,22 +204,44 @@ int main(void) {
     halInit();
     chSysInit();
     sdStart(&SD1, NULL);
+    log_init(serial);
     
-    chMtxObjectInit(&buffer_mutex);
-    chMtxObjectInit(&print_mutex);
-    chEvtObjectInit(&buffer_event);
+#if BUFFER_USE_MAILBOX
+    chGuardedPoolObjectInit(&item_pool, sizeof(Item));
+    chGuardedPoolLoadArray(&item_pool, item_objects, BUFFER_SIZE);
+    chMBObjectInit(&mailbox, mailbox_data, BUFFER_SIZE);
+#else
+    bring_init(&buffer, buffer_data, sizeof(Item), BUFFER_SIZE);
+#endif
+#if ITEM_TIMESTAMPS
+    lathist_init(&latency);
+#endif
     
     chThdCreateStatic(waProducer, sizeof(waProducer), NORMALPRIO, Producer, NULL);
     chThdCreateStatic(waConsumer, sizeof(waConsumer), NORMALPRIO, Consumer, NULL);
 
-    chMtxLock(&print_mutex);
-    chprintf(serial, "\r\n=== Producer-Consumer Demo ===\r\n");
-    chprintf(serial, "Producer: generates every %u ms\r\n", produser_speed);
-    chprintf(serial, "Consumer: processes every %u ms\r\n", consumer_speed);
-    chprintf(serial, "Buffer size: %d items\r\n\r\n", BUFFER_SIZE);
-    chMtxUnlock(&print_mutex);
+    log_printf("\r\n=== Producer-Consumer Demo ===\r\n");
+    log_printf("Producer: generates every %u ms\r\n", produser_speed);
+    log_printf("Consumer: processes every %u ms\r\n", consumer_speed);
+    log_printf("Burst: %d items, batch: up to %d items\r\n", PRODUCER_BURST, CONSUMER_BATCH);
+    log_printf("Buffer size: %d items (%s)\r\n\r\n", BUFFER_SIZE,
+               BUFFER_USE_MAILBOX ? "mailbox + memory pool" : "ring");
 
+    // Основной поток - монитор: гистограмма задержки вместо содержимого буфера
     while (true) {
-        chThdSleepMilliseconds(1000);
+        chThdSleepMilliseconds(MONITOR_INTERVAL);
+        
+#if ITEM_TIMESTAMPS
+        log_printf("\r\n=== Queueing Delay (buffer: %2u/%d) ===\r\n",
+                   buffer_count(), BUFFER_SIZE);
+        lathist_print(&latency, "Consumer");
+        log_printf("====================\r\n\r\n");
+#endif
+#if CTRACE_ENABLED
+        // Трасса - в файл один раз, после окна захвата
+        if (!ctrace_poll()) {
+            log_printf("Trace: cannot write %s\r\n", CTRACE_FILE);
+        }
+#endif
     }
 }
\ No newline at end of file
@@ -619,7 +619,7 @@
  * @note    The default is @p CH_DBG_TRACE_MASK_DISABLED.
  */
 #if !defined(CH_DBG_TRACE_MASK)
-#define CH_DBG_TRACE_MASK                   CH_DBG_TRACE_MASK_DISABLED
+#define CH_DBG_TRACE_MASK                   CH_DBG_TRACE_MASK_ALL
 #endif
 
 /**
@@ -693,6 +693,7 @@
  */
 #define CH_CFG_SYSTEM_INIT_HOOK() {                                         \
   /* Add system initialization code here.*/                                 \
+  stats_init();                                                             \
 }
 
 /**
@@ -716,7 +717,9 @@
  * @details User fields added to the end of the @p thread_t structure.
  */
 #define CH_CFG_THREAD_EXTRA_FIELDS                                          \
-  /* Add threads custom fields here.*/
+  /* Add threads custom fields here.*/                                      \
+  uint32_t stats_switches;                                                  \
+  uint64_t stats_runtime;
 
 /**
  * @brief   Threads initialization hook.
@@ -729,6 +732,7 @@
  */
 #define CH_CFG_THREAD_INIT_HOOK(tp) {                                       \
   /* Add threads initialization code here.*/                                \
+  stats_thread_init(tp);                                                    \
 }
 
 /**
@@ -750,6 +754,7 @@
  */
 #define CH_CFG_CONTEXT_SWITCH_HOOK(ntp, otp) {                              \
   /* Context switch code here.*/                                            \
+  stats_switch(ntp, otp);                                                   \
 }
 
 /**
@@ -774,6 +779,7 @@
  */
 #define CH_CFG_IDLE_ENTER_HOOK() {                                          \
   /* Idle-enter code here.*/                                                \
+  stats_idle_enter();                                                       \
 }
 
 /**
@@ -784,6 +790,7 @@
  */
 #define CH_CFG_IDLE_LEAVE_HOOK() {                                          \
   /* Idle-leave code here.*/                                                \
+  stats_idle_leave();                                                       \
 }
 
 /**
@@ -810,6 +817,7 @@
  */
 #define CH_CFG_SYSTEM_HALT_HOOK(reason) {                                   \
   /* System halt code here.*/                                               \
+  ctrace_halt();                                                            \
 }
 
 /**
@@ -819,6 +827,8 @@
  */
 #define CH_CFG_TRACE_HOOK(tep) {                                            \
   /* Trace code here.*/                                                     \
+  ctrace_record((tep)->type, (tep)->state,                                  \
+                (tep)->u.user.up1, (tep)->u.user.up2);                      \
 }
 
 /**
@@ -831,6 +841,33 @@
 
 /** @} */
 
+/*===========================================================================*/
+/* Lab instrumentation (common/stats.c, pmutex.c, ctrace.c).                 */
+/*===========================================================================*/
+
+/* Thread runtime accounting, called from the hooks above.*/
+#define STATS_ENABLED                       TRUE
+
+/* Buffer mutexes contention and hold-time profiling.*/
+#if !defined(PMUTEX_PROFILING)
+#define PMUTEX_PROFILING                    TRUE
+#endif
+
+/* Chrome trace-event export of the kernel trace, called from the hooks
+   above.*/
+#define CTRACE_ENABLED                      TRUE
+
+#if !defined(_FROM_ASM_)
+struct ch_thread;
+void stats_init(void);
+void stats_thread_init(struct ch_thread *tp);
+void stats_switch(struct ch_thread *ntp, struct ch_thread *otp);
+void stats_idle_enter(void);
+void stats_idle_leave(void);
+void ctrace_record(unsigned type, unsigned state, void *p1, void *p2);
+void ctrace_halt(void);
+#endif
+
 /*===========================================================================*/
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
@@ -3,199 +3,497 @@
 #include "chprintf.h"
 #include "chmtx.h"
 #include "chevents.h"
+#include "ring.h"
+#include "log.h"
+#include "lathist.h"
+#include "stats.h"
+#include "pmutex.h"
+#include "ctrace.h"
+#include <string.h>
 
 static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
 
-#define BUFFER_SIZE 10
+#define BUFFER_SIZE 16 // Степень двойки для ring.h
 
-// Первый кольцевой буфер и его переменные состояния
-static int buffer1[BUFFER_SIZE];
-static size_t buffer1_head = 0;
-static size_t buffer1_tail = 0;
-static size_t buffer1_count = 0;
+// Метка времени постановки в очередь у каждого элемента: читатели собирают
+// гистограммы задержки в очереди, монитор их печатает
+#if !defined(ITEM_TIMESTAMPS)
+#define ITEM_TIMESTAMPS TRUE
+#endif
 
-// Второй кольцевой буфер и его переменные состояния
-static int buffer2[BUFFER_SIZE];
-static size_t buffer2_head = 0;
-static size_t buffer2_tail = 0;
-static size_t buffer2_count = 0;
+// Вариант передачи: FALSE - кольцо ring_t под мьютексом, элементы
+// копируются в кольцо и из него; TRUE - objects_fifo_t, элементы заполняются
+// и читаются прямо в объектах FIFO, без копий и без мьютекса
+#if !defined(BUFFER_USE_OBJFIFO)
+#define BUFFER_USE_OBJFIFO FALSE
+#endif
+
+// Полезная нагрузка сообщения, байт: от 4 до 4096, чтобы видеть, с какого
+// размера копирование в кольцо обходится дороже передачи объектов
+#if !defined(MESSAGE_SIZE)
+#define MESSAGE_SIZE 4
+#endif
+
+#if (MESSAGE_SIZE < 4) || (MESSAGE_SIZE > 4096)
+#error "MESSAGE_SIZE must be 4..4096"
+#endif
+
+#define REPORT_PERIOD 10 // Отчеты монитора - раз в столько проходов
+
+typedef struct {
+    int value;
+#if ITEM_TIMESTAMPS
+    rtcnt_t stamp; // chSysGetRealtimeCounterX() в момент записи
+#endif
+    uint8_t payload[MESSAGE_SIZE]; // Заполняется младшим байтом value
+} Item;
 
 // Скорости работы задач
 static size_t task1_speed = 200;
 static size_t task2_speed = 300;
 static size_t monitor_speed = 100;
+#define TASK_BATCH 4 // Элементов за один захват мьютекса буфера
 
-// Мьютексы для синхронизации
-static mutex_t buffer1_mutex;
-static mutex_t buffer2_mutex;
-static mutex_t print_mutex;
+// В кольцевом варианте пачки элементов копируются через стек задачи
+// (при записи и при чтении; после встраивания функций - в одном кадре)
+#define TASK_STACK_SIZE (256 + 2 * TASK_BATCH * sizeof(Item))
 
-// События для синхронизации
+// Буфер между задачами и то, что относится только к нему
+typedef struct {
+#if BUFFER_USE_OBJFIFO
+    objects_fifo_t fifo;
+    msg_t fifo_msgs[BUFFER_SIZE];
+#else
+    ring_t ring;
+    pmutex_t mutex;
+#endif
+    Item data[BUFFER_SIZE];
+#if ITEM_TIMESTAMPS
+    lathist_t latency; // Задержка в очереди, пишет только читатель буфера
+#endif
+    uint32_t errors;   // Элементов с испорченной нагрузкой, тоже от читателя
+} Buffer;
+
+static Buffer buffer1;
+static Buffer buffer2;
+
+// События для синхронизации: данные записаны / место освободилось
 static event_source_t buffer1_event;
 static event_source_t buffer2_event;
+static event_source_t buffer1_space_event;
+static event_source_t buffer2_space_event;
+
+// Причины пробуждения задачи, все ждутся одним chEvtWaitAny()
+#define EVT_PEER_DATA EVENT_MASK(0) // В буфере соседа появились данные
+#define EVT_OWN_SPACE EVENT_MASK(1) // В своем буфере освободилось место
+#define EVT_TICK      EVENT_MASK(2) // Период записи (task*_speed)
+
+// Периодические таймеры записи задач
+static virtual_timer_t task1_tick;
+static virtual_timer_t task2_tick;
 
-static int number_counter = 1;
+// Пробуждения и перенесенные элементы (записанные и прочитанные) задачи
+typedef struct {
+    uint32_t wakeups;
+    uint32_t items;
+} TaskStats;
 
-static void print_buffer_state(const char* name, int* buffer, size_t head, size_t tail, size_t count);
+static TaskStats task1_stats;
+static TaskStats task2_stats;
+
+static int number_counter = 1; // Общий для задач, номера берутся пачкой атомарно
+
+static void print_buffer_state(const char* name, Buffer *bp);
+static void print_task_stats(const char* name, const TaskStats *stats);
+
+static void buffer_init(Buffer *bp, const char *name) {
+#if BUFFER_USE_OBJFIFO
+    (void)name;
+    chFifoObjectInit(&bp->fifo, sizeof(Item), BUFFER_SIZE, bp->data, bp->fifo_msgs);
+#else
+    ring_init(&bp->ring, bp->data, sizeof(Item), BUFFER_SIZE);
+    pmutex_init(&bp->mutex, name);
+#endif
+#if ITEM_TIMESTAMPS
+    lathist_init(&bp->latency);
+#endif
+    bp->errors = 0;
+}
+
+// Элементов в буфере; в кольцевом варианте - под мьютексом буфера
+static size_t buffer_count(Buffer *bp) {
+#if BUFFER_USE_OBJFIFO
+    chSysLock();
+    size_t count = chMBGetUsedCountI(&bp->fifo.mbx);
+    chSysUnlock();
+    return count;
+#else
+    return ring_count(&bp->ring);
+#endif
+}
+
+static void item_fill(Item *item, int value) {
+    item->value = value;
+#if ITEM_TIMESTAMPS
+    item->stamp = chSysGetRealtimeCounterX();
+#endif
+    memset(item->payload, value, MESSAGE_SIZE);
+}
+
+static void item_consume(Buffer *bp, const Item *item) {
+#if ITEM_TIMESTAMPS
+    // Задержка в очереди: от записи до чтения
+    lathist_add(&bp->latency, chSysGetRealtimeCounterX() - item->stamp);
+#endif
+    // Нагрузка читается целиком в обоих вариантах: иначе сравнение
+    // копирования с передачей указателя мерило бы "копирование против ничего"
+    uint8_t diff = 0;
+    for (size_t i = 0; i < MESSAGE_SIZE; i++) {
+        diff |= item->payload[i] ^ (uint8_t)item->value;
+    }
+    if (diff != 0U) {
+        bp->errors++;
+    }
+}
+
+// Запись до n (не больше TASK_BATCH) элементов с номерами от first.
+// Возвращает число записанных, *count - заполненность буфера после записи
+static size_t buffer_write(Buffer *bp, size_t n, int first, size_t *count) {
+    size_t added = 0;
+#if BUFFER_USE_OBJFIFO
+    // Свободный объект заполняется на месте и уходит читателю указателем
+    while (added < n) {
+        Item *item = chFifoTakeObjectTimeout(&bp->fifo, TIME_IMMEDIATE);
+        if (item == NULL) {
+            break;
+        }
+        item_fill(item, first + (int)added);
+        chFifoSendObject(&bp->fifo, item);
+        added++;
+    }
+    *count = buffer_count(bp);
+#else
+    // Пачка собирается в стеке и копируется в кольцо за один захват мьютекса
+    Item items[TASK_BATCH];
+    for (size_t i = 0; i < n; i++) {
+        item_fill(&items[i], first + (int)i);
+    }
+    
+    pmutex_lock(&bp->mutex);
+    added = ring_put_n(&bp->ring, items, n);
+    *count = buffer_count(bp);
+    pmutex_unlock(&bp->mutex);
+#endif
+    return added;
+}
+
+// Чтение до max (не больше TASK_BATCH) элементов без ожидания.
+// Возвращает число прочитанных, номера первого и последнего - в *first/*last
+static size_t buffer_read(Buffer *bp, size_t max, int *first, int *last, size_t *count) {
+    size_t got = 0;
+#if BUFFER_USE_OBJFIFO
+    // Объект читается на месте и возвращается в пул FIFO
+    void *objp;
+    while ((got < max) &&
+           (chFifoReceiveObjectTimeout(&bp->fifo, &objp, TIME_IMMEDIATE) == MSG_OK)) {
+        const Item *item = objp;
+        if (got == 0) {
+            *first = item->value;
+        }
+        *last = item->value;
+        item_consume(bp, item);
+        chFifoReturnObject(&bp->fifo, objp);
+        got++;
+    }
+    *count = buffer_count(bp);
+#else
+    Item items[TASK_BATCH];
+    
+    pmutex_lock(&bp->mutex);
+    got = ring_get_n(&bp->ring, items, max);
+    *count = buffer_count(bp);
+    pmutex_unlock(&bp->mutex);
+    
+    for (size_t i = 0; i < got; i++) {
+        item_consume(bp, &items[i]);
+    }
+    if (got > 0) {
+        *first = items[0].value;
+        *last = items[got - 1].value;
+    }
+#endif
+    return got;
+}
+
+// Таймер поднимает EVT_TICK задаче, переданной в p
+static void tick_cb(virtual_timer_t *vtp, void *p) {
+    (void)vtp;
+    chSysLockFromISR();
+    chEvtSignalI((thread_t *)p, EVT_TICK);
+    chSysUnlockFromISR();
+}
 
 // Задача 1: запись в буфер 1, чтение из буфера 2
-static THD_WORKING_AREA(waTask1, 256);
+static THD_WORKING_AREA(waTask1, TASK_STACK_SIZE);
 static THD_FUNCTION(Task1, arg) {
     (void)arg;
-    event_listener_t el;
-    chEvtRegister(&buffer2_event, &el, 0);
+    chRegSetThreadName("Task1");
+    event_listener_t data_el, space_el;
+    chEvtRegisterMask(&buffer2_event, &data_el, EVT_PEER_DATA);
+    chEvtRegisterMask(&buffer1_space_event, &space_el, EVT_OWN_SPACE);
+    chVTSetContinuous(&task1_tick, TIME_MS2I(task1_speed), tick_cb, chThdGetSelfX());
+    size_t pending = 0; // Элементов пачки, еще не поместившихся в буфер 1
+    int next = 0;       // Номер первого из них
     
     while (true) {
-        // 1. Сначала запись в буфер 1
-        int num = number_counter++;
+        // Одно ожидание на все причины: спим, только пока делать нечего.
+        // Место в своем буфере интересно, только пока есть что записать
+        eventmask_t evt = chEvtWaitAny(EVT_PEER_DATA | EVT_TICK |
+                                       ((pending > 0) ? EVT_OWN_SPACE : 0));
+        task1_stats.wakeups++;
         
-        chMtxLock(&buffer1_mutex);
-        if (buffer1_count == BUFFER_SIZE) {
-            chMtxUnlock(&buffer1_mutex);
-            
-            chMtxLock(&print_mutex);
-            chprintf(serial, "[TASK1] Buffer1 full, skipping write\r\n");
-            chMtxUnlock(&print_mutex);
-        } else {
-            buffer1[buffer1_head] = num;
-            buffer1_head = (buffer1_head + 1) % BUFFER_SIZE;
-            buffer1_count++;
-            
-            chMtxLock(&print_mutex);
-            chprintf(serial, "[TASK1] Added to buffer1: %3d (count: %2u/10)\r\n", num, buffer1_count);
-            chMtxUnlock(&print_mutex);
-            
-            chEvtBroadcast(&buffer1_event);
-            chMtxUnlock(&buffer1_mutex);
+        // 1. Новая пачка по таймеру; не поместившийся остаток прошлой теряется
+        if ((evt & EVT_TICK) != 0) {
+            if (pending > 0) {
+                LOG_TRACE("[TASK1] Buffer1 full, skipping %u writes\r\n", pending);
+            }
+            pending = TASK_BATCH;
+            // Номера пачки заняты сразу: счетчик общий с другой задачей, а
+            // запись может ждать мьютекс буфера. Номера потерянного остатка
+            // пропускаются
+            next = __atomic_fetch_add(&number_counter, TASK_BATCH, __ATOMIC_RELAXED);
+            // Флаг места, оставшийся с тех пор, как писать было нечего, устарел:
+            // запись ниже и так увидит текущее состояние буфера
+            (void)chEvtGetAndClearEvents(EVT_OWN_SPACE);
         }
         
-        // 2. Затем чтение из буфера 2 (без ожидания внутри мьютекса)
-        eventmask_t evt = chEvtWaitOneTimeout(EVENT_MASK(0), TIME_MS2I(10));
-        if (evt != 0) {
-            chMtxLock(&buffer2_mutex);
-            if (buffer2_count > 0) {
-                int num = buffer2[buffer2_tail];
-                buffer2_tail = (buffer2_tail + 1) % BUFFER_SIZE;
-                buffer2_count--;
-                
-                chMtxLock(&print_mutex);
-                chprintf(serial, "[TASK1] Read from buffer2: %3d (count: %2u/10)\r\n", num, buffer2_count);
-                chMtxUnlock(&print_mutex);
+        // 2. Запись ожидающей пачки: по таймеру или как только освободилось место
+        if (pending > 0) {
+            int first = next;
+            size_t count;
+            size_t added = buffer_write(&buffer1, pending, first, &count);
+            
+            // Сигнал и вывод уже вне мьютекса буфера
+            if (added > 0) {
+                next += (int)added;
+                chEvtBroadcast(&buffer1_event);
+                pending -= added;
+                task1_stats.items += added;
+                LOG_TRACE("[TASK1] Added to buffer1: %3d..%3d (count: %2u/%d)\r\n",
+                          first, first + (int)added - 1, count, BUFFER_SIZE);
             }
-            chMtxUnlock(&buffer2_mutex);
         }
         
-        chThdSleepMilliseconds(task1_speed);
+        // 3. Чтение всего накопившегося в буфере 2
+        if ((evt & EVT_PEER_DATA) != 0) {
+            size_t got, total = 0;
+            
+            // Флаг события один на любое число записей, поэтому за одно
+            // пробуждение забирается все накопившееся, пачками по TASK_BATCH
+            do {
+                int first, last;
+                size_t count;
+                got = buffer_read(&buffer2, TASK_BATCH, &first, &last, &count);
+                if (got > 0) {
+                    LOG_TRACE("[TASK1] Read from buffer2: %3d..%3d (count: %2u/%d)\r\n",
+                              first, last, count, BUFFER_SIZE);
+                }
+                total += got;
+            } while (got == TASK_BATCH);
+            
+            if (total > 0) {
+                chEvtBroadcast(&buffer2_space_event);
+                task1_stats.items += total;
+            }
+        }
     }
 }
 
-// Задача 2: чтение из буфера 1, запись в буфер 2
-static THD_WORKING_AREA(waTask2, 256);
+// Задача 2: запись в буфер 2, чтение из буфера 1
+static THD_WORKING_AREA(waTask2, TASK_STACK_SIZE);
 static THD_FUNCTION(Task2, arg) {
     (void)arg;
-    event_listener_t el;
-    chEvtRegister(&buffer1_event, &el, 0);
+    chRegSetThreadName("Task2");
+    event_listener_t data_el, space_el;
+    chEvtRegisterMask(&buffer1_event, &data_el, EVT_PEER_DATA);
+    chEvtRegisterMask(&buffer2_space_event, &space_el, EVT_OWN_SPACE);
+    chVTSetContinuous(&task2_tick, TIME_MS2I(task2_speed), tick_cb, chThdGetSelfX());
+    size_t pending = 0; // Элементов пачки, еще не поместившихся в буфер 2
+    int next = 0;       // Номер первого из них
     
     while (true) {
-        // 1. Сначала чтение из буфера 1 (без ожидания внутри мьютекса)
-        eventmask_t evt = chEvtWaitOneTimeout(EVENT_MASK(0), TIME_MS2I(10));
-        if (evt != 0) {
-            chMtxLock(&buffer1_mutex);
-            if (buffer1_count > 0) {
-                int num = buffer1[buffer1_tail];
-                buffer1_tail = (buffer1_tail + 1) % BUFFER_SIZE;
-                buffer1_count--;
-                
-                chMtxLock(&print_mutex);
-                chprintf(serial, "[TASK2] Read from buffer1: %3d (count: %2u/10)\r\n", num, buffer1_count);
-                chMtxUnlock(&print_mutex);
+        // Одно ожидание на все причины: спим, только пока делать нечего.
+        // Место в своем буфере интересно, только пока есть что записать
+        eventmask_t evt = chEvtWaitAny(EVT_PEER_DATA | EVT_TICK |
+                                       ((pending > 0) ? EVT_OWN_SPACE : 0));
+        task2_stats.wakeups++;
+        
+        // 1. Новая пачка по таймеру; не поместившийся остаток прошлой теряется
+        if ((evt & EVT_TICK) != 0) {
+            if (pending > 0) {
+                LOG_TRACE("[TASK2] Buffer2 full, skipping %u writes\r\n", pending);
             }
-            chMtxUnlock(&buffer1_mutex);
+            pending = TASK_BATCH;
+            next = __atomic_fetch_add(&number_counter, TASK_BATCH, __ATOMIC_RELAXED);
+            // Устаревший флаг места сбрасывается, как в задаче 1
+            (void)chEvtGetAndClearEvents(EVT_OWN_SPACE);
         }
         
-        // 2. Затем запись в буфер 2
-        int num = number_counter++;
-        
-        chMtxLock(&buffer2_mutex);
-        if (buffer2_count == BUFFER_SIZE) {
-            chMtxUnlock(&buffer2_mutex);
+        // 2. Запись ожидающей пачки: по таймеру или как только освободилось место
+        if (pending > 0) {
+            int first = next;
+            size_t count;
+            size_t added = buffer_write(&buffer2, pending, first, &count);
             
-            chMtxLock(&print_mutex);
-            chprintf(serial, "[TASK2] Buffer2 full, skipping write\r\n");
-            chMtxUnlock(&print_mutex);
-        } else {
-            buffer2[buffer2_head] = num;
-            buffer2_head = (buffer2_head + 1) % BUFFER_SIZE;
-            buffer2_count++;
+            // Сигнал и вывод уже вне мьютекса буфера
+            if (added > 0) {
+                next += (int)added;
+                chEvtBroadcast(&buffer2_event);
+                pending -= added;
+                task2_stats.items += added;
+                LOG_TRACE("[TASK2] Added to buffer2: %3d..%3d (count: %2u/%d)\r\n",
+                          first, first + (int)added - 1, count, BUFFER_SIZE);
+            }
+        }
+        
+        // 3. Чтение всего накопившегося в буфере 1
+        if ((evt & EVT_PEER_DATA) != 0) {
+            size_t got, total = 0;
             
-            chMtxLock(&print_mutex);
-            chprintf(serial, "[TASK2] Added to buffer2: %3d (count: %2u/10)\r\n", num, buffer2_count);
-            chMtxUnlock(&print_mutex);
+            // Флаг события один на любое число записей, поэтому за одно
+            // пробуждение забирается все накопившееся, пачками по TASK_BATCH
+            do {
+                int first, last;
+                size_t count;
+                got = buffer_read(&buffer1, TASK_BATCH, &first, &last, &count);
+                if (got > 0) {
+                    LOG_TRACE("[TASK2] Read from buffer1: %3d..%3d (count: %2u/%d)\r\n",
+                              first, last, count, BUFFER_SIZE);
+                }
+                total += got;
+            } while (got == TASK_BATCH);
             
-            chEvtBroadcast(&buffer2_event);
-            chMtxUnlock(&buffer2_mutex);
+            if (total > 0) {
+                chEvtBroadcast(&buffer1_space_event);
+                task2_stats.items += total;
+            }
         }
-        
-        chThdSleepMilliseconds(task2_speed);
     }
 }
 
 // Задача мониторинга: вывод состояния буферов
-static THD_WORKING_AREA(waMonitor, 256);
+static THD_WORKING_AREA(waMonitor, 512);
 static THD_FUNCTION(Monitor, arg) {
     (void)arg;
+    chRegSetThreadName("Monitor");
+    unsigned pass = 0;
+#if STATS_ENABLED
+    static stats_snapshot_t snapshot;
+#endif
     
     while (true) {
+#if !BUFFER_USE_OBJFIFO
         // Сначала блокируем оба буфера, затем выводим
-        chMtxLock(&buffer1_mutex);
-        chMtxLock(&buffer2_mutex);
+        pmutex_lock(&buffer1.mutex);
+        pmutex_lock(&buffer2.mutex);
+#endif
         
-        chMtxLock(&print_mutex);
-        chprintf(serial, "\r\n=== Buffer Status ===\r\n");
+        log_printf("\r\n=== Buffer Status ===\r\n");
         
-        print_buffer_state("Buffer1", buffer1, buffer1_head, buffer1_tail, buffer1_count);
-        print_buffer_state("Buffer2", buffer2, buffer2_head, buffer2_tail, buffer2_count);
+        print_buffer_state("Buffer1", &buffer1);
+        print_buffer_state("Buffer2", &buffer2);
         
-        chprintf(serial, "====================\r\n\r\n");
-        chMtxUnlock(&print_mutex);
+        log_printf("====================\r\n\r\n");
         
-        chMtxUnlock(&buffer2_mutex);
-        chMtxUnlock(&buffer1_mutex);
+#if !BUFFER_USE_OBJFIFO
+        pmutex_unlock(&buffer2.mutex);
+        pmutex_unlock(&buffer1.mutex);
+#endif
+        
+        // Гистограммы и загрузка - не под мьютексами буферов, реже и в разных
+        // проходах: иначе переполнят лог
+        pass++;
+        if (pass % REPORT_PERIOD == 0) {
+            log_printf("=== Task Wakeups ===\r\n");
+            print_task_stats("Task1", &task1_stats);
+            print_task_stats("Task2", &task2_stats);
+#if ITEM_TIMESTAMPS
+            log_printf("=== Queueing Delay ===\r\n");
+            lathist_print(&buffer1.latency, "Buffer1");
+            lathist_print(&buffer2.latency, "Buffer2");
+#endif
+            log_printf("====================\r\n\r\n");
+        }
+#if STATS_ENABLED
+        if (pass % REPORT_PERIOD == REPORT_PERIOD / 3) {
+            stats_snapshot(&snapshot);
+            log_printf("=== CPU Usage ===\r\n");
+            stats_print(&snapshot);
+            log_printf("====================\r\n\r\n");
+        }
+#endif
+#if PMUTEX_PROFILING && !BUFFER_USE_OBJFIFO
+        if (pass % REPORT_PERIOD == REPORT_PERIOD * 2 / 3) {
+            log_printf("=== Mutex Profile ===\r\n");
+            pmutex_report();
+            log_printf("====================\r\n\r\n");
+        }
+#endif
+#if CTRACE_ENABLED
+        // Трасса - в файл один раз, после окна захвата
+        if (!ctrace_poll()) {
+            log_printf("Trace: cannot write %s\r\n", CTRACE_FILE);
+        }
+#endif
         
         chThdSleepMilliseconds(monitor_speed);
     }
 }
 
 // Функция для вывода состояния буфера
-static void print_buffer_state(const char* name, int* buffer, size_t head, size_t tail, size_t count) {
-    chprintf(serial, "%s: count=%2u, head=%2u, tail=%2u\r\n", name, count, head, tail);
-    chprintf(serial, "Contents: ");
+// Содержимое не выводится: задержку в очереди показывают гистограммы
+static void print_buffer_state(const char* name, Buffer *bp) {
+#if BUFFER_USE_OBJFIFO
+    chSysLock();
+    size_t count = chMBGetUsedCountI(&bp->fifo.mbx);
+    cnt_t free_objects = chGuardedPoolGetCounterI(&bp->fifo.free);
+    chSysUnlock();
+    log_printf("%s: count=%2u, free objects=%2d, errors=%u\r\n", name, count,
+               (int)free_objects, bp->errors);
+#else
+    log_printf("%s: count=%2u, head=%2u, tail=%2u, errors=%u\r\n", name,
+               ring_count(&bp->ring), ring_head_pos(&bp->ring), ring_tail_pos(&bp->ring),
+               bp->errors);
+#endif
+}
+
+// Пробуждений на 100 перенесенных элементов: чем меньше, тем меньше пустых
+static void print_task_stats(const char* name, const TaskStats *stats) {
+    uint32_t wakeups = stats->wakeups;
+    uint32_t items = stats->items;
     
-    if (count == 0) {
-        chprintf(serial, "empty");
-    } else {
-        size_t idx = tail;
-        for (size_t i = 0; i < count; i++) {
-            chprintf(serial, "%3d ", buffer[idx]);
-            idx = (idx + 1) % BUFFER_SIZE;
-        }
-    }
-    chprintf(serial, "\r\n");
+    log_printf("%s: wakeups=%u, items=%u, wakeups per 100 items=%u\r\n",
+               name, wakeups, items,
+               (items > 0U) ? (uint32_t)((uint64_t)wakeups * 100U / items) : 0U);
 }
 
 int main(void) {
     halInit();
     chSysInit();
     sdStart(&SD1, NULL);
+    log_init(serial);
     
-    // Инициализация мьютексов
-    chMtxObjectInit(&buffer1_mutex);
-    chMtxObjectInit(&buffer2_mutex);
-    chMtxObjectInit(&print_mutex);
+    // Инициализация буферов (и их мьютексов в кольцевом варианте)
+    buffer_init(&buffer1, "buffer1");
+    buffer_init(&buffer2, "buffer2");
     
     // Инициализация событий
     chEvtObjectInit(&buffer1_event);
     chEvtObjectInit(&buffer2_event);
+    chEvtObjectInit(&buffer1_space_event);
+    chEvtObjectInit(&buffer2_space_event);
+    chVTObjectInit(&task1_tick);
+    chVTObjectInit(&task2_tick);
     
     // Создание задач
     chThdCreateStatic(waTask1, sizeof(waTask1), NORMALPRIO, Task1, NULL);
@@ -203,13 +501,12 @@ int main(void) {
     chThdCreateStatic(waMonitor, sizeof(waMonitor), NORMALPRIO-1, Monitor, NULL);
 
     // Вывод информации о запуске
-    chMtxLock(&print_mutex);
-    chprintf(serial, "\r\n=== Dual Ring Buffer Demo ===\r\n");
-    chprintf(serial, "Task1 speed: %u ms (writes to buffer1, reads from buffer2)\r\n", task1_speed);
-    chprintf(serial, "Task2 speed: %u ms (reads from buffer1, writes to buffer2)\r\n", task2_speed);
-    chprintf(serial, "Monitor speed: %u ms\r\n", monitor_speed);
-    chprintf(serial, "Buffer size: %d items each\r\n\r\n", BUFFER_SIZE);
-    chMtxUnlock(&print_mutex);
+    log_printf("\r\n=== Dual Ring Buffer Demo ===\r\n");
+    log_printf("Task1 speed: %u ms (writes to buffer1, reads from buffer2)\r\n", task1_speed);
+    log_printf("Task2 speed: %u ms (reads from buffer1, writes to buffer2)\r\n", task2_speed);
+    log_printf("Monitor speed: %u ms\r\n", monitor_speed);
+    log_printf("Buffer size: %d items each, %d-byte payload (%s)\r\n\r\n",
+               BUFFER_SIZE, MESSAGE_SIZE, BUFFER_USE_OBJFIFO ? "objects FIFO" : "ring");
 
     while (true) {
         chThdSleepMilliseconds(1000);
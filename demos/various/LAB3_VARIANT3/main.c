@@ -1,157 +1,508 @@
 #include "ch.h"
 #include "hal.h"
 #include "chprintf.h"
-#include <stdlib.h>
+#include "ring.h"
+#include "log.h"
+#include "prng.h"
+#include "rwlock.h"
+#include "mpmc.h"
+#include <string.h>
 
 static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
-static mutex_t print_mutex;  // Мьютекс для синхронизации вывода
 
-#define BUFFER_SIZE 10
-#define USER_TASKS 10
+#define BUFFER_SIZE 16 // Степень двойки для ring.h
+#if !defined(USER_TASKS)
+#define USER_TASKS 10         // Можно задать тысячи: -DUSER_TASKS=2000
+#endif
+#if !defined(WORKER_THREADS)
+#define WORKER_THREADS 4      // Размер пула рабочих потоков
+#endif
+#if !defined(TICKET_BUFFERS)
+#define TICKET_BUFFERS 2      // Число буферов (шардов) хранилища
+#endif
 #define MONITOR_INTERVAL 1000 // 1 second
+#if !defined(RANDOM_SEED)
+#define RANDOM_SEED 12345     // Общий seed генераторов задач: тот же seed - тот же прогон
+#endif
+#define POLICY_PERIOD 5       // Интервалов монитора на каждую политику выбора буфера
+#define BUFFER_LOCK_TIMEOUT TIME_MS2I(5) // Дольше ждать блокировку - буфер "занят"
+#if !defined(TICKET_PAYLOAD_SIZE)
+#define TICKET_PAYLOAD_SIZE 32 // Байт полезной нагрузки тикета
+#endif
+#if !defined(TICKET_POOL_SIZE)
+#define TICKET_POOL_SIZE (TICKET_BUFFERS * BUFFER_SIZE) // Тикетов в пуле
+#endif
+#define TICKET_ALLOC_TIMEOUT TIME_MS2I(50) // Дольше ждать свободный тикет - "полон"
+
+#if TICKET_PAYLOAD_SIZE < 1
+#error "TICKET_PAYLOAD_SIZE must be at least 1"
+#endif
+
+// Реализация буфера: TRUE - lock-free MPMC очередь из mpmc.h, параллельные
+// операции не отказывают с "занят"; FALSE - кольцо из ring.h под блокировкой
+// читатели/писатель, с просмотром без извлечения
+#if !defined(TICKET_USE_MPMC)
+#define TICKET_USE_MPMC TRUE
+#endif
+
+// Тикет: объект из пула, в буферах хранятся только указатели на него,
+// поэтому размер нагрузки не влияет ни на размер буферов, ни на копирование
+typedef struct {
+    int id;
+    uint8_t payload[TICKET_PAYLOAD_SIZE];
+} Ticket;
 
 // Структура для буфера
+#if TICKET_USE_MPMC
 typedef struct {
-    int data[BUFFER_SIZE];
-    size_t head;
-    size_t tail;
-    size_t count;
-    int readers;
-    int writers;
+    size_t data[MPMC_STORAGE_WORDS(sizeof(Ticket *), BUFFER_SIZE)];
+    mpmc_t queue;
 } TicketBuffer;
+#else
+typedef struct {
+    Ticket *data[BUFFER_SIZE];
+    ring_t ring;
+    rwlock_t lock; // Просмотр - общий доступ, изменение - монопольный
+} TicketBuffer;
+#endif
 
 // Структура для пользовательской задачи
 typedef struct {
-    systime_t last_run;
-    systime_t interval;
+    virtual_timer_t vt; // Таймер следующего запуска
     int task_num;
+    prng_t rng;         // Собственный генератор задачи
 } UserTask;
 
-// Два буфера
-static TicketBuffer buffer1, buffer2;
+// Хранилище тикетов: TICKET_BUFFERS буферов-шардов. У каждой задачи свой
+// домашний шард, чтение из пустого шарда крадет тикет у соседей
+static TicketBuffer buffers[TICKET_BUFFERS];
+
+// Счетчики шардов для монитора
+typedef struct {
+    uint32_t writes; // Успешных записей
+    uint32_t reads;  // Успешных чтений, включая украденные
+    uint32_t steals; // Чтений, выполненных вместо пустого соседа
+    uint32_t spills; // Записей, принятых вместо полного соседа
+    uint32_t fails;  // Отказов: полон / пуст / занят
+    uint32_t busy;   // Недавние отказы "занят", монитор раз в интервал делит пополам
+} ShardStats;
+
+static ShardStats shard_stats[TICKET_BUFFERS];
+
+static inline void shard_inc(uint32_t *counter) {
+    __atomic_fetch_add(counter, 1U, __ATOMIC_RELAXED);
+}
+
+// Пул тикетов: объекты фиксированного размера вместо выделения из кучи
+// на каждую запись, без фрагментации. Пул с семафором: на пустом пуле
+// писатель ждет, пока читатель вернет тикет
+static Ticket ticket_objects[TICKET_POOL_SIZE];
+static guarded_memory_pool_t ticket_pool;
+
+// Счетчики пула для монитора
+typedef struct {
+    uint32_t in_use;     // Выдано тикетов сейчас
+    uint32_t high_water; // Максимум in_use с запуска
+    uint32_t waits;      // Выделений, ждавших свободный тикет
+    uint32_t timeouts;   // Из них не дождавшихся за TICKET_ALLOC_TIMEOUT
+    uint32_t corrupted;  // Прочитано тикетов с испорченной нагрузкой
+} PoolStats;
+
+static PoolStats pool_stats;
 
 // Пользовательские задачи
 static UserTask user_tasks[USER_TASKS];
 
+// Очередь заданий пула: таймеры ставят сюда наступившие задачи.
+// Каждая задача взводит таймер заново только после выполнения, поэтому
+// дескрипторов достаточно по одному на задачу. Все задачи одного
+// приоритета, поэтому очередь одна
+static job_descriptor_t jobs_buffer[USER_TASKS];
+static msg_t jobs_msg_buffer[USER_TASKS];
+static jobs_queue_t jobs;
+
+// Рабочие потоки пула и число выполненных каждым заданий
+static THD_WORKING_AREA(waWorkers[WORKER_THREADS], 512);
+static uint32_t worker_ops[WORKER_THREADS];
+
+// Тикет из пула, NULL - пул пуст дольше TICKET_ALLOC_TIMEOUT. Ожидание
+// ограничено: читатели выполняются теми же рабочими потоками, и писатели,
+// занявшие все потоки пула, ждали бы вечно
+static Ticket *ticket_alloc(int id) {
+    Ticket *tp = chGuardedPoolAllocTimeout(&ticket_pool, TIME_IMMEDIATE);
+    if (tp == NULL) {
+        shard_inc(&pool_stats.waits);
+        tp = chGuardedPoolAllocTimeout(&ticket_pool, TICKET_ALLOC_TIMEOUT);
+        if (tp == NULL) {
+            shard_inc(&pool_stats.timeouts);
+            return NULL;
+        }
+    }
+    
+    // Максимум обновляется CAS-ом: выделять могут несколько потоков сразу
+    uint32_t in_use = __atomic_add_fetch(&pool_stats.in_use, 1U, __ATOMIC_RELAXED);
+    uint32_t high = __atomic_load_n(&pool_stats.high_water, __ATOMIC_RELAXED);
+    while ((in_use > high) &&
+           !__atomic_compare_exchange_n(&pool_stats.high_water, &high, in_use, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    
+    tp->id = id;
+    memset(tp->payload, (uint8_t)id, sizeof(tp->payload));
+    return tp;
+}
+
+// Возврат тикета в пул, будит ждущего писателя
+static void ticket_free(Ticket *tp) {
+    __atomic_fetch_sub(&pool_stats.in_use, 1U, __ATOMIC_RELAXED);
+    chGuardedPoolFree(&ticket_pool, tp);
+}
+
+// Прочитанный тикет: проверка всей нагрузки, возврат в пул, результат - номер
+static int ticket_consume(Ticket *tp) {
+    int id = tp->id;
+    
+    for (size_t i = 0; i < sizeof(tp->payload); i++) {
+        if (tp->payload[i] != (uint8_t)id) {
+            shard_inc(&pool_stats.corrupted);
+            break;
+        }
+    }
+    ticket_free(tp);
+    return id;
+}
+
+// Результат операций с буфером: MSG_OK - выполнено, MSG_TIMEOUT - буфер
+// занят дольше BUFFER_LOCK_TIMEOUT, MSG_RESET - буфер пуст / полон
+
+#if TICKET_USE_MPMC
 // Инициализация буфера
 static void buffer_init(TicketBuffer *buf) {
-    buf->head = 0;
-    buf->tail = 0;
-    buf->count = 0;
-    buf->readers = 0;
-    buf->writers = 0;
+    mpmc_init(&buf->queue, buf->data, sizeof(Ticket *), BUFFER_SIZE);
 }
 
-// Защищенный вывод
-static void safe_print(const char *fmt, ...) {
-    chMtxLock(&print_mutex);
-    va_list ap;
-    va_start(ap, fmt);
-    chvprintf(serial, fmt, ap);
-    va_end(ap);
-    chMtxUnlock(&print_mutex);
+// Чтение из буфера, потребителей может быть сколько угодно
+static msg_t buffer_read(TicketBuffer *buf, Ticket **tpp) {
+    return mpmc_get(&buf->queue, tpp) ? MSG_OK : MSG_RESET;
 }
 
-// Попытка чтения из буфера
-static bool buffer_read(TicketBuffer *buf, int *value) {
-    if (buf->writers > 0) {
-        return false; // Есть писатель - чтение невозможно
-    }
-    
-    if (buf->count == 0) {
-        return false; // Буфер пуст
+// Запись в буфер, производителей может быть сколько угодно
+static msg_t buffer_write(TicketBuffer *buf, Ticket *tp) {
+    return mpmc_put(&buf->queue, &tp) ? MSG_OK : MSG_RESET;
+}
+
+// Заполненность буфера для политик выбора, без блокировки - приблизительно
+static size_t buffer_count(TicketBuffer *buf) {
+    return mpmc_count(&buf->queue);
+}
+
+// Вывод состояния буфера: содержимое очереди без блокировок не снять
+static void buffer_print(TicketBuffer *buf, const char *name) {
+    log_printf("%s: count=%2u, head=%2u, tail=%2u\r\n", name,
+               mpmc_count(&buf->queue), buf->queue.head & buf->queue.mask,
+               buf->queue.tail & buf->queue.mask);
+}
+#else
+// Инициализация буфера
+static void buffer_init(TicketBuffer *buf) {
+    ring_init(&buf->ring, buf->data, sizeof(Ticket *), BUFFER_SIZE);
+    rwlock_init(&buf->lock);
+}
+
+// Чтение из буфера: извлечение сдвигает tail, поэтому доступ монопольный
+static msg_t buffer_read(TicketBuffer *buf, Ticket **tpp) {
+    if (rwlock_write_lock_timeout(&buf->lock, BUFFER_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
     }
     
-    buf->readers++;
-    *value = buf->data[buf->tail];
-    buf->tail = (buf->tail + 1) % BUFFER_SIZE;
-    buf->count--;
-    buf->readers--;
+    bool ok = ring_get(&buf->ring, tpp);
+    rwlock_write_unlock(&buf->lock);
     
-    return true;
+    return ok ? MSG_OK : MSG_RESET;
 }
 
-// Попытка записи в буфер
-static bool buffer_write(TicketBuffer *buf, int value) {
-    if (buf->readers > 0 || buf->writers > 0) {
-        return false; // Есть читатели или писатели - запись невозможна
+// Просмотр первого элемента без извлечения: читатели работают параллельно.
+// Номер берется под блокировкой - после нее тикет может уже вернуться в пул
+static msg_t buffer_peek(TicketBuffer *buf, int *value) {
+    if (rwlock_read_lock_timeout(&buf->lock, BUFFER_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
     }
     
-    if (buf->count == BUFFER_SIZE) {
-        return false; // Буфер полон
+    Ticket *tp;
+    bool ok = ring_peek(&buf->ring, 0, &tp);
+    if (ok) {
+        *value = tp->id;
+    }
+    rwlock_read_unlock(&buf->lock);
+    
+    return ok ? MSG_OK : MSG_RESET;
+}
+
+// Запись в буфер, монопольный доступ
+static msg_t buffer_write(TicketBuffer *buf, Ticket *tp) {
+    if (rwlock_write_lock_timeout(&buf->lock, BUFFER_LOCK_TIMEOUT) != MSG_OK) {
+        return MSG_TIMEOUT;
     }
     
-    buf->writers++;
-    buf->data[buf->head] = value;
-    buf->head = (buf->head + 1) % BUFFER_SIZE;
-    buf->count++;
-    buf->writers--;
+    bool ok = ring_put(&buf->ring, &tp);
+    rwlock_write_unlock(&buf->lock);
     
-    return true;
+    return ok ? MSG_OK : MSG_RESET;
+}
+
+// Заполненность буфера для политик выбора, без блокировки - приблизительно
+static size_t buffer_count(TicketBuffer *buf) {
+    return ring_count(&buf->ring);
 }
 
 // Вывод состояния буфера
 static void buffer_print(TicketBuffer *buf, const char *name) {
-    safe_print("%s: count=%2u, head=%2u, tail=%2u\r\n", 
-              name, buf->count, buf->head, buf->tail);
-    safe_print("Contents: ");
+    // Снимок под общей блокировкой, вывод - уже после ее освобождения
+    rwlock_read_lock(&buf->lock);
+    size_t count = ring_count(&buf->ring);
+    size_t head = ring_head_pos(&buf->ring);
+    size_t tail = ring_tail_pos(&buf->ring);
     
-    if (buf->count == 0) {
-        safe_print("empty");
+    // Строка содержимого собирается целиком и уходит в лог одной записью
+    char line[LOG_LINE_SIZE];
+    size_t len = (size_t)chsnprintf(line, sizeof(line), "Contents: ");
+    if (count == 0) {
+        chsnprintf(&line[len], sizeof(line) - len, "empty");
     } else {
-        size_t idx = buf->tail;
-        for (size_t i = 0; i < buf->count; i++) {
-            safe_print("%3d ", buf->data[idx]);
-            idx = (idx + 1) % BUFFER_SIZE;
+        Ticket *tp;
+        for (size_t i = 0; ring_peek(&buf->ring, i, &tp) && (len < sizeof(line)); i++) {
+            len += (size_t)chsnprintf(&line[len], sizeof(line) - len, "%3d ", tp->id);
         }
     }
-    safe_print("\r\n");
+    rwlock_read_unlock(&buf->lock);
+    
+    log_printf("%s: count=%2u, head=%2u, tail=%2u\r\n", name, count, head, tail);
+    log_printf("%s\r\n", line);
+}
+#endif
+
+// Политика выбора буфера для операции (write - запись, иначе чтение),
+// возвращает номер буфера
+typedef struct {
+    const char *name;
+    size_t (*select)(UserTask *task, bool write);
+} SelectPolicy;
+
+// Случайный буфер, как было изначально
+static size_t select_random(UserTask *task, bool write) {
+    (void)write;
+    return prng_below(&task->rng, TICKET_BUFFERS);
+}
+
+// Два случайных кандидата: писатель берет менее заполненный, читатель - более
+static size_t select_two_choices(UserTask *task, bool write) {
+    size_t a = prng_below(&task->rng, TICKET_BUFFERS);
+    size_t b = prng_below(&task->rng, TICKET_BUFFERS);
+    size_t count_a = buffer_count(&buffers[a]);
+    size_t count_b = buffer_count(&buffers[b]);
+    
+    if (write) {
+        return (count_b < count_a) ? b : a;
+    }
+    return (count_b > count_a) ? b : a;
+}
+
+// Буферы по кругу
+static size_t select_round_robin(UserTask *task, bool write) {
+    static uint32_t next;
+    (void)task;
+    (void)write;
+    return __atomic_fetch_add(&next, 1U, __ATOMIC_RELAXED) % TICKET_BUFFERS;
+}
+
+#if !TICKET_USE_MPMC
+// Буфер с наименьшим числом недавних отказов "занят". Обход начинается с
+// разных буферов, чтобы при равенстве не выбирать всегда первый. Очередь
+// MPMC "занят" не отвечает никогда, с ней политика совпала бы с round-robin
+static size_t select_least_contended(UserTask *task, bool write) {
+    size_t start = select_round_robin(task, write);
+    size_t best = start;
+    
+    for (size_t i = 1; i < TICKET_BUFFERS; i++) {
+        size_t n = (start + i) % TICKET_BUFFERS;
+        if (shard_stats[n].busy < shard_stats[best].busy) {
+            best = n;
+        }
+    }
+    return best;
+}
+#endif
+
+// Домашний шард задачи: стабильный (мультипликативный) хеш ее номера,
+// задачи расходятся по шардам равномерно при любом TICKET_BUFFERS
+static size_t select_home_shard(UserTask *task, bool write) {
+    (void)write;
+    return ((uint32_t)task->task_num * 2654435761U) % TICKET_BUFFERS;
+}
+
+// Политики работают по очереди по POLICY_PERIOD интервалов монитора,
+// монитор выводит успешность и пропускную способность каждой
+static const SelectPolicy policies[] = {
+    {"random",          select_random},
+    {"two-choices",     select_two_choices},
+    {"round-robin",     select_round_robin},
+#if !TICKET_USE_MPMC
+    {"least-contended", select_least_contended},
+#endif
+    {"home-shard",      select_home_shard},
+};
+#define POLICIES (sizeof(policies) / sizeof(policies[0]))
+
+static const SelectPolicy *policy = &policies[0];
+static uint32_t policy_ops; // Операций при текущей политике
+static uint32_t policy_ok;  // Из них успешных
+
+static void process_user_task(void *arg);
+
+// Callback таймера (контекст прерывания): только ставит задание в очередь
+static void dispatch_cb(virtual_timer_t *vtp, void *p) {
+    (void)vtp;
+    chSysLockFromISR();
+    job_descriptor_t *jp = chJobGetI(&jobs);
+    if (jp != NULL) {
+        jp->jobfunc = process_user_task;
+        jp->jobarg = p;
+        chJobPostI(&jobs, jp);
+    }
+    chSysUnlockFromISR();
+}
+
+// Взвод таймера задачи на случайный интервал 100-500 мс
+static void user_task_arm(UserTask *task) {
+    chVTSet(&task->vt, TIME_MS2I(100 + prng_below(&task->rng, 400)), dispatch_cb, task);
 }
 
 // Инициализация пользовательских задач
 static void init_user_tasks(void) {
     for (int i = 0; i < USER_TASKS; i++) {
         user_tasks[i].task_num = i + 1;
-        user_tasks[i].interval = 100 + rand() % 400; // Случайный интервал 100-500 мс
-        user_tasks[i].last_run = 0;
+        prng_seed(&user_tasks[i].rng, RANDOM_SEED, (uint32_t)user_tasks[i].task_num);
+        chVTObjectInit(&user_tasks[i].vt);
+        user_task_arm(&user_tasks[i]);
     }
 }
 
-// Обработка одной пользовательской задачи
-static void process_user_task(UserTask *task) {
-    systime_t now = chVTGetSystemTime();
+// Обработка одной пользовательской задачи, таймер которой сработал
+static void process_user_task(void *arg) {
+    UserTask *task = (UserTask *)arg;
     
-    if (now - task->last_run >= TIME_MS2I(task->interval)) {
-        // Случайный выбор буфера (1 или 2)
-        TicketBuffer *buf = (rand() % 2) ? &buffer1 : &buffer2;
-        const char *buf_name = (buf == &buffer1) ? "Buffer1" : "Buffer2";
-        
-        // Случайное действие (чтение или запись)
-        if (rand() % 2) {
-            // Запись
-            static int counter = 1;
-            int value = counter++;
-            if (buffer_write(buf, value)) {
-                safe_print("[Task %d] Wrote to %s: %d\r\n", 
-                          task->task_num, buf_name, value);
-            } else {
-                safe_print("[Task %d] %s is busy or full\r\n", 
-                          task->task_num, buf_name);
-            }
+    // Случайное действие: запись, чтение или просмотр (только под блокировкой)
+    int value;
+    Ticket *tp;
+    msg_t msg;
+    int action = (int)prng_below(&task->rng, TICKET_USE_MPMC ? 2 : 3);
+    
+    // Буфер выбирает текущая политика
+    size_t index = policy->select(task, action == 0);
+    TicketBuffer *buf = &buffers[index];
+    int buf_num = (int)index + 1;
+    if (action == 0) {
+        // Запись: тикет из пула, в буфер уходит указатель на него
+        static int counter = 1; // Общий для всех рабочих потоков
+        value = __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+        tp = ticket_alloc(value);
+        if (tp == NULL) {
+            msg = MSG_RESET;
+            LOG_TRACE("[Task %d] Ticket pool is exhausted\r\n", task->task_num);
         } else {
-            // Чтение
-            int value;
-            if (buffer_read(buf, &value)) {
-                safe_print("[Task %d] Read from %s: %d\r\n", 
-                          task->task_num, buf_name, value);
-            } else {
-                safe_print("[Task %d] %s is busy or empty\r\n", 
-                          task->task_num, buf_name);
+            msg = buffer_write(buf, tp);
+            if (msg == MSG_OK) {
+                shard_inc(&shard_stats[index].writes);
+                LOG_TRACE("[Task %d] Wrote to Buffer%d: %d\r\n", 
+                          task->task_num, buf_num, value);
+            } else if (msg == MSG_RESET) {
+                // Выбранный шард полон - пишем в соседей по кругу. Пул не больше
+                // суммы шардов, поэтому место для выделенного тикета где-то есть
+                for (size_t i = 1; (msg == MSG_RESET) && (i < TICKET_BUFFERS); i++) {
+                    size_t spill = (index + i) % TICKET_BUFFERS;
+                    if (buffer_write(&buffers[spill], tp) == MSG_OK) {
+                        msg = MSG_OK;
+                        shard_inc(&shard_stats[spill].writes);
+                        shard_inc(&shard_stats[spill].spills);
+                        LOG_TRACE("[Task %d] Spilled to Buffer%d: %d\r\n", 
+                                  task->task_num, (int)spill + 1, value);
+                    }
+                }
+                if (msg == MSG_RESET) {
+                    LOG_TRACE("[Task %d] Buffer%d is full\r\n", 
+                              task->task_num, buf_num);
+                }
+            }
+            if (msg != MSG_OK) {
+                ticket_free(tp);
             }
         }
-        
-        task->last_run = now;
-        task->interval = 100 + rand() % 400; // Новый случайный интервал
+    }
+#if !TICKET_USE_MPMC
+    else if (action == 2) {
+        // Просмотр
+        msg = buffer_peek(buf, &value);
+        if (msg == MSG_OK) {
+            LOG_TRACE("[Task %d] Peeked Buffer%d: %d\r\n", 
+                      task->task_num, buf_num, value);
+        } else if (msg == MSG_RESET) {
+            LOG_TRACE("[Task %d] Buffer%d is empty\r\n", 
+                      task->task_num, buf_num);
+        }
+    }
+#endif
+    else {
+        // Чтение
+        msg = buffer_read(buf, &tp);
+        if (msg == MSG_OK) {
+            value = ticket_consume(tp);
+            shard_inc(&shard_stats[index].reads);
+            LOG_TRACE("[Task %d] Read from Buffer%d: %d\r\n", 
+                      task->task_num, buf_num, value);
+        } else if (msg == MSG_RESET) {
+            // Выбранный шард пуст - крадем у соседей по кругу
+            for (size_t i = 1; (msg == MSG_RESET) && (i < TICKET_BUFFERS); i++) {
+                size_t victim = (index + i) % TICKET_BUFFERS;
+                if (buffer_read(&buffers[victim], &tp) == MSG_OK) {
+                    msg = MSG_OK;
+                    value = ticket_consume(tp);
+                    shard_inc(&shard_stats[victim].reads);
+                    shard_inc(&shard_stats[victim].steals);
+                    LOG_TRACE("[Task %d] Stole from Buffer%d: %d\r\n", 
+                              task->task_num, (int)victim + 1, value);
+                }
+            }
+            if (msg == MSG_RESET) {
+                LOG_TRACE("[Task %d] Buffer%d is empty\r\n", 
+                          task->task_num, buf_num);
+            }
+        }
+    }
+    if (msg == MSG_TIMEOUT) {
+        LOG_TRACE("[Task %d] Buffer%d is busy\r\n", task->task_num, buf_num);
+        shard_inc(&shard_stats[index].busy);
+    }
+    if (msg != MSG_OK) {
+        shard_inc(&shard_stats[index].fails);
+    }
+    
+    __atomic_fetch_add(&policy_ops, 1U, __ATOMIC_RELAXED);
+    if (msg == MSG_OK) {
+        __atomic_fetch_add(&policy_ok, 1U, __ATOMIC_RELAXED);
+    }
+    
+    user_task_arm(task); // Новый случайный интервал
+}
+
+// Рабочий поток пула: выполняет задания из общей очереди
+static THD_FUNCTION(Worker, arg) {
+    uint32_t *ops = (uint32_t *)arg;
+    chRegSetThreadName("Worker");
+    
+    while (true) {
+        if (chJobDispatch(&jobs) == MSG_OK) {
+            (*ops)++;
+        }
     }
 }
 
@@ -159,38 +510,76 @@ int main(void) {
     halInit();
     chSysInit();
     sdStart(&SD1, NULL);
-    chMtxObjectInit(&print_mutex); // Инициализация мьютекса
+    log_init(serial); // Вывод через отдельный поток
     
-    // Инициализация буферов
-    buffer_init(&buffer1);
-    buffer_init(&buffer2);
+    // Пул тикетов и буферы
+    chGuardedPoolObjectInit(&ticket_pool, sizeof(Ticket));
+    chGuardedPoolLoadArray(&ticket_pool, ticket_objects, TICKET_POOL_SIZE);
+    for (int i = 0; i < TICKET_BUFFERS; i++) {
+        buffer_init(&buffers[i]);
+    }
     
-    // Инициализация пользовательских задач
-    init_user_tasks();
+    // Очередь заданий и пул рабочих потоков
+    chJobObjectInit(&jobs, USER_TASKS, jobs_buffer, jobs_msg_buffer);
+    for (int i = 0; i < WORKER_THREADS; i++) {
+        chThdCreateStatic(waWorkers[i], sizeof(waWorkers[i]), NORMALPRIO,
+                          Worker, &worker_ops[i]);
+    }
     
-    safe_print("\r\n=== Ticket System with Two Buffers ===\r\n");
-    safe_print("Running %d user tasks in main loop...\r\n\r\n", USER_TASKS);
+    log_printf("\r\n=== Ticket System with %d Buffers ===\r\n", TICKET_BUFFERS);
+    log_printf("Running %d user tasks on %d worker threads...\r\n",
+               USER_TASKS, WORKER_THREADS);
+    log_printf("Ticket pool: %d tickets, %d-byte payload\r\n\r\n",
+               TICKET_POOL_SIZE, TICKET_PAYLOAD_SIZE);
     
-    systime_t last_monitor_time = 0;
+    // Инициализация пользовательских задач
+    init_user_tasks();
     
+    // Главный поток только выводит состояние буферов и пула
+    uint32_t last_ops[WORKER_THREADS] = {0};
+    int policy_ticks = 0;
+    systime_t next = chVTGetSystemTime();
     while (true) {
-        systime_t now = chVTGetSystemTime();
+        next = chThdSleepUntilWindowed(next, chTimeAddX(next, TIME_MS2I(MONITOR_INTERVAL)));
         
-        // Обработка всех пользовательских задач
-        for (int i = 0; i < USER_TASKS; i++) {
-            process_user_task(&user_tasks[i]);
+        log_printf("\r\n=== Buffer Status ===\r\n");
+        for (int i = 0; i < TICKET_BUFFERS; i++) {
+            char name[16];
+            chsnprintf(name, sizeof(name), "Buffer%d", i + 1);
+            buffer_print(&buffers[i], name);
+            ShardStats *st = &shard_stats[i];
+            log_printf("  writes=%u, reads=%u, steals=%u, spills=%u, fails=%u, busy=%u\r\n",
+                       st->writes, st->reads, st->steals, st->spills, st->fails, st->busy);
+            // Старые отказы постепенно забываются. Рабочие потоки тем временем
+            // могут добавить свои: деление CAS-ом, чтобы их не потерять
+            uint32_t busy = __atomic_load_n(&st->busy, __ATOMIC_RELAXED);
+            while (!__atomic_compare_exchange_n(&st->busy, &busy, busy / 2U, true,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            }
         }
-        
-        // Периодический вывод состояния буферов
-        if (now - last_monitor_time >= TIME_MS2I(MONITOR_INTERVAL)) {
-            safe_print("\r\n=== Buffer Status ===\r\n");
-            buffer_print(&buffer1, "Buffer1");
-            buffer_print(&buffer2, "Buffer2");
-            safe_print("====================\r\n\r\n");
-            last_monitor_time = now;
+        log_printf("Ticket pool: %u/%d in use, high water %u\r\n",
+                   pool_stats.in_use, TICKET_POOL_SIZE, pool_stats.high_water);
+        log_printf("  waits=%u, timeouts=%u, corrupted=%u\r\n",
+                   pool_stats.waits, pool_stats.timeouts, pool_stats.corrupted);
+        for (int i = 0; i < WORKER_THREADS; i++) {
+            uint32_t ops = worker_ops[i];
+            log_printf("Worker %d: %u ops/s\r\n", i + 1,
+                       (ops - last_ops[i]) * 1000U / MONITOR_INTERVAL);
+            last_ops[i] = ops;
         }
         
-        // Небольшая задержка для уменьшения нагрузки на CPU
-        chThdSleepMilliseconds(10);
+        // Итог политики за ее период и переход к следующей
+        if (++policy_ticks == POLICY_PERIOD) {
+            uint32_t ops = __atomic_exchange_n(&policy_ops, 0U, __ATOMIC_RELAXED);
+            uint32_t ok = __atomic_exchange_n(&policy_ok, 0U, __ATOMIC_RELAXED);
+            uint32_t ok_pm = (ops > 0U) ? (uint32_t)(((uint64_t)ok * 1000U) / ops) : 0U;
+            log_printf("Policy %s: %u ops, %u.%u%% ok, %u ops/s\r\n", policy->name,
+                       ops, ok_pm / 10U, ok_pm % 10U,
+                       ops * 1000U / (POLICY_PERIOD * MONITOR_INTERVAL));
+            policy = &policies[((size_t)(policy - policies) + 1U) % POLICIES];
+            policy_ticks = 0;
+        }
+        log_printf("Policy: %s\r\n", policy->name);
+        log_printf("====================\r\n\r\n");
     }
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "record.h"
+#include "prng.h"
+#include "log.h"
+#include <string.h>
+
+static BaseSequentialStream *serial = (BaseSequentialStream*) &SD1;
+
+#define PIPE_SIZE 256         // Байт в канале
+#define RECORD_MIN 4          // Тело записи: номер (4 байта) и заполнитель
+#define RECORD_MAX 64
+#define PRODUCER_BURST 8      // Записей за период, уходят в канал одной записью
+#define MONITOR_INTERVAL 5000 // Период вывода пропускной способности, мс
+
+#if !defined(RANDOM_SEED)
+#define RANDOM_SEED 12345
+#endif
+
+// Один писатель и один читатель - мьютекс каналу не нужен,
+// ожидание места / данных - внутри chPipeWriteTimeout()/chPipeReadTimeout()
+static uint8_t pipe_data[PIPE_SIZE];
+static pipe_t records_pipe;
+static size_t consumer_speed = 200;
+static size_t producer_speed = 800;
+
+static uint32_t record_counter = 1;
+
+// Счетчики для монитора, каждый пишет только один поток
+static uint32_t produced_records;
+static uint32_t produced_bytes;
+static uint32_t consumed_records;
+static uint32_t consumed_bytes;
+static uint32_t consumer_reads;
+static uint32_t consumer_errors;
+
+static size_t pipe_count(void) {
+    return chPipeGetUsedCount(&records_pipe);
+}
+
+static THD_WORKING_AREA(waProducer, 256);
+static THD_FUNCTION(Producer, arg) {
+    (void)arg;
+    chRegSetThreadName("Producer");
+    // Пачка собирается здесь целиком, заголовки и тела - на месте
+    static uint8_t burst[PRODUCER_BURST * RECORD_SIZE(RECORD_MAX)];
+    prng_t rng;
+    prng_seed(&rng, RANDOM_SEED, 0);
+
+    while (true) {
+        uint32_t first = record_counter;
+        size_t len = 0;
+
+        for (int i = 0; i < PRODUCER_BURST; i++) {
+            size_t body_len = RECORD_MIN + prng_below(&rng, RECORD_MAX - RECORD_MIN + 1);
+            uint8_t *body = record_start(&burst[len], body_len);
+            uint32_t seq = record_counter++;
+
+            memcpy(body, &seq, sizeof(seq));
+            memset(&body[sizeof(seq)], (uint8_t)seq, body_len - sizeof(seq));
+            len += RECORD_SIZE(body_len);
+        }
+
+        // Вся пачка - одним вызовом; ждем, только если канал переполнен
+        size_t written = chPipeWriteTimeout(&records_pipe, burst, len, TIME_IMMEDIATE);
+        if (written < len) {
+            LOG_TRACE("[PRODUCER] Waiting (pipe full)\r\n");
+
+            // Просыпаемся по мере того, как потребитель освобождает место
+            written += chPipeWriteTimeout(&records_pipe, &burst[written], len - written,
+                                          TIME_INFINITE);
+        }
+        produced_records += PRODUCER_BURST;
+        produced_bytes += (uint32_t)len;
+
+        LOG_TRACE("[PRODUCER] Added: %3u..%3u, %3u bytes (pipe: %3u)\r\n",
+                  first, record_counter - 1, len, pipe_count());
+
+        chThdSleepMilliseconds(producer_speed);
+    }
+}
+
+// Разобранные за одно чтение записи
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    uint32_t expected; // Номер следующей записи
+} ConsumeBatch;
+
+static void consume_record(void *arg, const uint8_t *body, size_t len) {
+    ConsumeBatch *batch = arg;
+    uint32_t seq;
+
+    // Номер читается только из достаточно длинного тела
+    if (len < sizeof(seq)) {
+        consumer_errors++;
+        return;
+    }
+    memcpy(&seq, body, sizeof(seq));
+    // У тела из одного номера заполнителя нет
+    if ((seq != batch->expected) ||
+        ((len > sizeof(seq)) && (body[len - 1] != (uint8_t)seq))) {
+        consumer_errors++;
+    }
+    if (batch->first == 0) {
+        batch->first = seq;
+    }
+    batch->last = seq;
+    batch->expected = seq + 1;
+}
+
+static THD_WORKING_AREA(waConsumer, 256);
+static THD_FUNCTION(Consumer, arg) {
+    (void)arg;
+    chRegSetThreadName("Consumer");
+    // Хотя бы одна самая длинная запись плюс запас на много записей за чтение
+    static uint8_t parse_data[PIPE_SIZE + RECORD_SIZE(RECORD_MAX)];
+    record_parser_t parser;
+    record_parser_init(&parser, parse_data, sizeof(parse_data));
+    uint32_t expected = 1;
+
+    while (true) {
+        size_t room;
+        uint8_t *dst = record_parser_space(&parser, &room);
+
+        // Блокировка - только на пустом канале: ждем первый байт,
+        // затем одним вызовом забираем все, что уже есть
+        size_t n = chPipeReadTimeout(&records_pipe, dst, 1, TIME_INFINITE);
+        n += chPipeReadTimeout(&records_pipe, &dst[n], room - n, TIME_IMMEDIATE);
+
+        ConsumeBatch batch = {0, 0, expected};
+        size_t records = record_parser_commit(&parser, n, consume_record, &batch);
+        expected = batch.expected;
+        consumer_reads++;
+        consumed_records += (uint32_t)records;
+        consumed_bytes += (uint32_t)n;
+
+        if (records > 0) {
+            LOG_TRACE("[CONSUMER] Processed: %3u..%3u, %3u bytes (pipe: %3u)\r\n",
+                      batch.first, batch.last, n, pipe_count());
+        }
+
+        chThdSleepMilliseconds(consumer_speed);
+    }
+}
+
+// Скорость за интервал: count единиц за elapsed мкс
+static uint32_t per_second(uint32_t count, rtcnt_t elapsed) {
+    return (elapsed > 0U) ? (uint32_t)(((uint64_t)count * 1000000U) / elapsed) : 0U;
+}
+
+int main(void) {
+    halInit();
+    chSysInit();
+    sdStart(&SD1, NULL);
+    log_init(serial);
+
+    chPipeObjectInit(&records_pipe, pipe_data, PIPE_SIZE);
+
+    chThdCreateStatic(waProducer, sizeof(waProducer), NORMALPRIO, Producer, NULL);
+    chThdCreateStatic(waConsumer, sizeof(waConsumer), NORMALPRIO, Consumer, NULL);
+
+    log_printf("\r\n=== Pipe Records Demo ===\r\n");
+    log_printf("Producer: %d records every %u ms\r\n", PRODUCER_BURST, producer_speed);
+    log_printf("Consumer: reads every %u ms\r\n", consumer_speed);
+    log_printf("Record body: %d..%d bytes + %u-byte length\r\n",
+               RECORD_MIN, RECORD_MAX, RECORD_HEADER_SIZE);
+    log_printf("Pipe size: %d bytes\r\n\r\n", PIPE_SIZE);
+
+    // Основной поток - монитор: пропускная способность в записях и байтах
+    uint32_t records = 0, bytes = 0, reads = 0;
+    rtcnt_t last = chSysGetRealtimeCounterX();
+    while (true) {
+        chThdSleepMilliseconds(MONITOR_INTERVAL);
+
+        rtcnt_t now = chSysGetRealtimeCounterX();
+        rtcnt_t elapsed = now - last;
+        uint32_t d_records = consumed_records - records;
+        uint32_t d_bytes = consumed_bytes - bytes;
+        uint32_t d_reads = consumer_reads - reads;
+        last = now;
+        records += d_records;
+        bytes += d_bytes;
+        reads += d_reads;
+
+        log_printf("\r\n=== Throughput (pipe: %3u/%d) ===\r\n", pipe_count(), PIPE_SIZE);
+        log_printf("Produced: %u records, %u bytes\r\n", produced_records, produced_bytes);
+        log_printf("Consumed: %u records/s, %u bytes/s\r\n",
+                   per_second(d_records, elapsed), per_second(d_bytes, elapsed));
+        log_printf("Per read: %u records, %u bytes; errors: %u\r\n",
+                   (d_reads > 0U) ? d_records / d_reads : 0U,
+                   (d_reads > 0U) ? d_bytes / d_reads : 0U, consumer_errors);
+        log_printf("====================\r\n\r\n");
+    }
+}
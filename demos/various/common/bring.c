@@ -0,0 +1,124 @@
+#include "bring.h"
+
+void bring_init(bring_t *brp, void *storage, size_t item_size, size_t capacity) {
+    ring_init(&brp->ring, storage, item_size, capacity);
+    chSemObjectInit(&brp->free, (cnt_t)capacity);
+    chSemObjectInit(&brp->filled, 0);
+    brp->reserved = 0;
+    brp->peeked = 0;
+}
+
+msg_t bring_put(bring_t *brp, const void *item, sysinterval_t timeout) {
+    msg_t msg = chSemWaitTimeout(&brp->free, timeout);
+    if (msg != MSG_OK) {
+        return msg;
+    }
+    
+    // Слот зарезервирован семафором, запись не может не удаться
+    (void)ring_put(&brp->ring, item);
+    chSemSignal(&brp->filled);
+    
+    return MSG_OK;
+}
+
+msg_t bring_get(bring_t *brp, void *item, sysinterval_t timeout) {
+    msg_t msg = chSemWaitTimeout(&brp->filled, timeout);
+    if (msg != MSG_OK) {
+        return msg;
+    }
+    
+    (void)ring_get(&brp->ring, item);
+    chSemSignal(&brp->free);
+    
+    return MSG_OK;
+}
+
+// Ждет первый отсчет семафора, затем без ожидания добирает остальные доступные
+static size_t bring_take(semaphore_t *sp, size_t n, sysinterval_t timeout) {
+    if ((n == 0U) || (chSemWaitTimeout(sp, timeout) != MSG_OK)) {
+        return 0;
+    }
+    
+    size_t taken = 1;
+    chSysLock();
+    while ((taken < n) && (chSemGetCounterI(sp) > 0)) {
+        chSemFastWaitI(sp);
+        taken++;
+    }
+    chSysUnlock();
+    
+    return taken;
+}
+
+// Возвращает n отсчетов семафору одной операцией
+static void bring_give(semaphore_t *sp, size_t n) {
+    chSysLock();
+    chSemAddCounterI(sp, (cnt_t)n);
+    chSchRescheduleS();
+    chSysUnlock();
+}
+
+size_t bring_put_n(bring_t *brp, const void *src, size_t n, sysinterval_t timeout) {
+    size_t count = bring_take(&brp->free, n, timeout);
+    if (count > 0U) {
+        (void)ring_put_n(&brp->ring, src, count);
+        bring_give(&brp->filled, count);
+    }
+    
+    return count;
+}
+
+size_t bring_get_n(bring_t *brp, void *dst, size_t max, sysinterval_t timeout) {
+    size_t count = bring_take(&brp->filled, max, timeout);
+    if (count > 0U) {
+        (void)ring_get_n(&brp->ring, dst, count);
+        bring_give(&brp->free, count);
+    }
+    
+    return count;
+}
+
+void *bring_reserve(bring_t *brp, size_t *n, sysinterval_t timeout) {
+    // Не больше, чем до конца массива: пропусков bip-буфера здесь не бывает
+    size_t contig = ring_capacity(&brp->ring) - ring_head_pos(&brp->ring);
+    
+    brp->reserved = bring_take(&brp->free, (*n < contig) ? *n : contig, timeout);
+    *n = brp->reserved;
+    
+    return (*n > 0U) ? ring_reserve(&brp->ring, *n) : NULL;
+}
+
+void bring_commit(bring_t *brp, size_t n) {
+    chDbgAssert(n <= brp->reserved, "commit exceeds reservation");
+    
+    ring_commit(&brp->ring, n);
+    if (n > 0U) {
+        bring_give(&brp->filled, n);
+    }
+    if (brp->reserved > n) {
+        bring_give(&brp->free, brp->reserved - n);
+    }
+    brp->reserved = 0;
+}
+
+void *bring_peek(bring_t *brp, size_t *n, sysinterval_t timeout) {
+    size_t contig = ring_capacity(&brp->ring) - ring_tail_pos(&brp->ring);
+    
+    brp->peeked = bring_take(&brp->filled, (*n < contig) ? *n : contig, timeout);
+    *n = brp->peeked;
+    
+    return (*n > 0U) ? ring_peek_span(&brp->ring, n) : NULL;
+}
+
+void bring_release(bring_t *brp, size_t n) {
+    chDbgAssert(n <= brp->peeked, "release exceeds peek");
+    
+    ring_release(&brp->ring, n);
+    if (n > 0U) {
+        bring_give(&brp->free, n);
+    }
+    if (brp->peeked > n) {
+        bring_give(&brp->filled, brp->peeked - n);
+    }
+    brp->peeked = 0;
+}
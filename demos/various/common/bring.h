@@ -0,0 +1,44 @@
+#ifndef BRING_H
+#define BRING_H
+
+#include "ch.h"
+#include "ring.h"
+
+// Блокирующее кольцо: SPSC ring_t плюс пара счетных семафоров.
+// free считает свободные слоты, filled - заполненные, поэтому производитель
+// просыпается сразу, как только потребитель освободит слот, и наоборот.
+typedef struct {
+    ring_t ring;
+    semaphore_t free;
+    semaphore_t filled;
+    size_t reserved; // Слотов выдано bring_reserve(), производитель
+    size_t peeked;   // Элементов выдано bring_peek(), потребитель
+} bring_t;
+
+void bring_init(bring_t *brp, void *storage, size_t item_size, size_t capacity);
+
+// MSG_OK - элемент передан, MSG_TIMEOUT - истек timeout (TIME_IMMEDIATE - без ожидания)
+msg_t bring_put(bring_t *brp, const void *item, sysinterval_t timeout);
+msg_t bring_get(bring_t *brp, void *item, sysinterval_t timeout);
+
+// Пакетные варианты: ждут хотя бы один слот/элемент не дольше timeout,
+// затем забирают все доступные (до n) за одну критическую секцию.
+// Возвращают число перенесенных элементов, 0 - истек timeout
+size_t bring_put_n(bring_t *brp, const void *src, size_t n, sysinterval_t timeout);
+size_t bring_get_n(bring_t *brp, void *dst, size_t max, sysinterval_t timeout);
+
+// Zero-copy варианты: ждут хотя бы один слот/элемент не дольше timeout и
+// возвращают непрерывный участок кольца (до конца массива), *n - его длина.
+// NULL - истек timeout. Производитель заполняет участок на месте и вызывает
+// bring_commit(), потребитель обрабатывает на месте и вызывает bring_release();
+// n в них может быть меньше выданного, остаток возвращается кольцу.
+void *bring_reserve(bring_t *brp, size_t *n, sysinterval_t timeout);
+void bring_commit(bring_t *brp, size_t n);
+void *bring_peek(bring_t *brp, size_t *n, sysinterval_t timeout);
+void bring_release(bring_t *brp, size_t n);
+
+static inline size_t bring_count(const bring_t *brp) {
+    return ring_count(&brp->ring);
+}
+
+#endif
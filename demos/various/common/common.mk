@@ -0,0 +1,16 @@
+# Общие исходники лабораторных работ (кольцевые буферы и т.п.).
+LABCOMMONDIR := ../common
+
+LABCOMMONSRC := $(LABCOMMONDIR)/ring.c \
+                $(LABCOMMONDIR)/bring.c \
+                $(LABCOMMONDIR)/log.c \
+                $(LABCOMMONDIR)/dsched.c \
+                $(LABCOMMONDIR)/rwlock.c \
+                $(LABCOMMONDIR)/mpmc.c \
+                $(LABCOMMONDIR)/lathist.c \
+                $(LABCOMMONDIR)/stats.c \
+                $(LABCOMMONDIR)/pmutex.c \
+                $(LABCOMMONDIR)/ctrace.c \
+                $(LABCOMMONDIR)/record.c
+
+LABCOMMONINC := $(LABCOMMONDIR)
@@ -0,0 +1,175 @@
+#include <stdio.h>
+
+#include "ctrace.h"
+
+#if CTRACE_ENABLED
+
+typedef struct {
+    rtcnt_t stamp;
+    uint8_t type;
+    uint8_t state;
+    void *p1;
+    void *p2;
+} ctrace_rec_t;
+
+// Кольцо пишется только из хука, т.е. под блокировкой ядра
+static ctrace_rec_t ctrace_ring[CTRACE_RING_SIZE];
+static uint32_t ctrace_head;     // Всего записей с начала работы
+static bool ctrace_paused;       // Идет выгрузка, запись запрещена
+static uint32_t ctrace_lost;
+
+static const char *const ctrace_states[] = {CH_STATE_NAMES};
+
+void ctrace_record(unsigned type, unsigned state, void *p1, void *p2) {
+    if (ctrace_paused) {
+        ctrace_lost++;
+        return;
+    }
+
+    ctrace_rec_t *rp = &ctrace_ring[ctrace_head & (CTRACE_RING_SIZE - 1U)];
+    rp->stamp = chSysGetRealtimeCounterX();
+    rp->type = (uint8_t)type;
+    rp->state = (uint8_t)state;
+    rp->p1 = p1;
+    rp->p2 = p2;
+    ctrace_head++;
+}
+
+// Номер дорожки потока: 0 - ISR, потоки с 1 в порядке появления
+static unsigned ctrace_tid(thread_t **threads, size_t *count, thread_t *tp) {
+    for (size_t i = 0; i < *count; i++) {
+        if (threads[i] == tp) {
+            return (unsigned)i + 1U;
+        }
+    }
+    if (*count < CTRACE_MAX_THREADS) {
+        threads[*count] = tp;
+        return (unsigned)++(*count);
+    }
+    return CTRACE_MAX_THREADS + 1U; // Общая дорожка для остальных
+}
+
+static void ctrace_comma(FILE *f, bool *first) {
+    fputs(*first ? "\n" : ",\n", f);
+    *first = false;
+}
+
+// Запись файла, вызывается при остановленном сборе
+static bool ctrace_write(void) {
+    FILE *f = fopen(CTRACE_FILE, "w");
+    if (f == NULL) {
+        return false;
+    }
+
+    uint32_t head = ctrace_head;
+    uint32_t n = (head < CTRACE_RING_SIZE) ? head : CTRACE_RING_SIZE;
+    thread_t *threads[CTRACE_MAX_THREADS];
+    size_t count = 0;
+    thread_t *running = NULL; // Поток, получивший процессор последним
+    uint64_t running_since = 0;
+    uint64_t ts = 0;          // Время от первой записи окна, мкс
+    rtcnt_t prev = ctrace_ring[(head - n) & (CTRACE_RING_SIZE - 1U)].stamp;
+    bool first = true;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+
+    for (uint32_t i = head - n; i != head; i++) {
+        const ctrace_rec_t *rp = &ctrace_ring[i & (CTRACE_RING_SIZE - 1U)];
+
+        // Разности переживают переполнение 32-битного счетчика
+        ts += (rtcnt_t)(rp->stamp - prev);
+        prev = rp->stamp;
+
+        switch (rp->type) {
+        case CH_TRACE_TYPE_SWITCH:
+            // Интервал уходящего потока закрывается с его новым состоянием
+            if (running != NULL) {
+                ctrace_comma(f, &first);
+                fprintf(f, "{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":\"run\","
+                        "\"ts\":%llu,\"dur\":%llu,\"args\":{\"then\":\"%s\"}}",
+                        ctrace_tid(threads, &count, running),
+                        (unsigned long long)running_since,
+                        (unsigned long long)(ts - running_since),
+                        (rp->state < sizeof(ctrace_states) / sizeof(ctrace_states[0])) ?
+                            ctrace_states[rp->state] : "?");
+            }
+            running = (thread_t *)rp->p1;
+            running_since = ts;
+            break;
+        case CH_TRACE_TYPE_ISR_ENTER:
+        case CH_TRACE_TYPE_ISR_LEAVE:
+            ctrace_comma(f, &first);
+            fprintf(f, "{\"ph\":\"%s\",\"pid\":1,\"tid\":0,\"name\":\"%s\",\"ts\":%llu}",
+                    (rp->type == CH_TRACE_TYPE_ISR_ENTER) ? "B" : "E",
+                    (rp->p1 != NULL) ? (const char *)rp->p1 : "isr",
+                    (unsigned long long)ts);
+            break;
+        case CH_TRACE_TYPE_HALT:
+            ctrace_comma(f, &first);
+            fprintf(f, "{\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"name\":\"halt: %s\","
+                    "\"ts\":%llu}", (rp->p1 != NULL) ? (const char *)rp->p1 : "",
+                    (unsigned long long)ts);
+            break;
+        case CH_TRACE_TYPE_USER:
+            ctrace_comma(f, &first);
+            fprintf(f, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"name\":\"user\","
+                    "\"ts\":%llu,\"args\":{\"up1\":\"%p\",\"up2\":\"%p\"}}",
+                    (running != NULL) ? ctrace_tid(threads, &count, running) : 0U,
+                    (unsigned long long)ts, rp->p1, rp->p2);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Имена дорожек - из реестра на момент выгрузки
+    ctrace_comma(f, &first);
+    fputs("{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"thread_name\","
+          "\"args\":{\"name\":\"ISR\"}}", f);
+    for (size_t i = 0; i < count; i++) {
+        const char *name = chRegGetThreadNameX(threads[i]);
+        ctrace_comma(f, &first);
+        fprintf(f, "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+                "\"args\":{\"name\":\"%s\"}}", (unsigned)i + 1U,
+                (name != NULL) ? name : "?");
+    }
+
+    fputs("\n]}\n", f);
+    return fclose(f) == 0;
+}
+
+void ctrace_halt(void) {
+    // Ядро уже заблокировано и больше не продолжит работу
+    ctrace_paused = true;
+    (void)ctrace_write();
+}
+
+bool ctrace_dump(void) {
+    chSysLock();
+    ctrace_paused = true;
+    chSysUnlock();
+
+    bool ok = ctrace_write();
+
+    chSysLock();
+    ctrace_paused = false;
+    chSysUnlock();
+
+    return ok;
+}
+
+bool ctrace_poll(void) {
+    static bool dumped;
+
+    if (dumped || (chVTGetSystemTime() < TIME_MS2I(CTRACE_CAPTURE_MS))) {
+        return true;
+    }
+    dumped = true;
+    return ctrace_dump();
+}
+
+uint32_t ctrace_dropped(void) {
+    return ctrace_lost;
+}
+
+#endif
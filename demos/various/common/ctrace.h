@@ -0,0 +1,62 @@
+#ifndef CTRACE_H
+#define CTRACE_H
+
+#include "ch.h"
+
+// Сборщик трассы ядра для симулятора. CH_CFG_TRACE_HOOK кладет каждую
+// запись трассы ChibiOS (переключения, вход/выход ISR, останов, события
+// пользователя) в собственное кольцо с 32-битной меткой счетчика реального
+// времени (на SIMIA32 это мкс) - в записи ядра метка только 24-битная.
+// По запросу кольцо выгружается в файл в формате Chrome trace-event JSON
+// (chrome://tracing, ui.perfetto.dev): дорожка на поток с интервалами
+// выполнения, отдельная дорожка для ISR.
+//
+// Лаба подключает сборщик в cfg/chconf.h: CTRACE_ENABLED TRUE,
+// CH_DBG_TRACE_MASK не CH_DBG_TRACE_MASK_DISABLED и вызовы ctrace_record()
+// и ctrace_halt() из CH_CFG_TRACE_HOOK и CH_CFG_SYSTEM_HALT_HOOK.
+
+#if !defined(CTRACE_ENABLED)
+#define CTRACE_ENABLED FALSE
+#endif
+
+// Число записей в кольце, степень двойки. При переполнении затираются
+// самые старые: в файл попадает последнее окно
+#if !defined(CTRACE_RING_SIZE)
+#define CTRACE_RING_SIZE 8192
+#endif
+
+// Файл трассы в текущем каталоге процесса симулятора
+#if !defined(CTRACE_FILE)
+#define CTRACE_FILE "trace.json"
+#endif
+
+// Окно захвата для ctrace_poll(), мс от запуска системы
+#if !defined(CTRACE_CAPTURE_MS)
+#define CTRACE_CAPTURE_MS 10000
+#endif
+
+// Сколько разных потоков различает выгрузка
+#if !defined(CTRACE_MAX_THREADS)
+#define CTRACE_MAX_THREADS 16
+#endif
+
+#if CTRACE_ENABLED
+// Хуки, вызываются ядром в критической секции.
+// p1/p2 - первые два указателя объединения u записи трассы
+void ctrace_record(unsigned type, unsigned state, void *p1, void *p2);
+void ctrace_halt(void);
+
+// Выгрузка в CTRACE_FILE из потока. На время записи файла сбор
+// приостанавливается, пропущенные события учитываются в ctrace_dropped()
+bool ctrace_dump(void);
+
+// Однократная выгрузка по окончании окна захвата, монитор лабы вызывает ее
+// на каждом проходе. Запись файла блокирующая и останавливает все потоки,
+// поэтому периодическая выгрузка исказила бы и задержки, и саму трассу.
+// false - не удалось записать файл
+bool ctrace_poll(void);
+
+uint32_t ctrace_dropped(void);
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#include "dsched.h"
+
+// Дедлайны сравниваются относительно epoch, а не напрямую: системное время
+// заворачивается, а все дедлайны в куче лежат не раньше epoch
+static bool dsched_before(const dsched_t *sp, const dsched_task_t *a, const dsched_task_t *b) {
+    return chTimeDiffX(sp->epoch, a->deadline) < chTimeDiffX(sp->epoch, b->deadline);
+}
+
+static void dsched_swap(dsched_t *sp, size_t i, size_t j) {
+    dsched_task_t *tp = sp->heap[i];
+    sp->heap[i] = sp->heap[j];
+    sp->heap[j] = tp;
+}
+
+static void dsched_sift_up(dsched_t *sp, size_t i) {
+    while (i > 0U) {
+        size_t parent = (i - 1U) / 2U;
+        if (!dsched_before(sp, sp->heap[i], sp->heap[parent])) {
+            break;
+        }
+        dsched_swap(sp, i, parent);
+        i = parent;
+    }
+}
+
+static void dsched_sift_down(dsched_t *sp, size_t i) {
+    while (true) {
+        size_t left = 2U * i + 1U;
+        size_t right = left + 1U;
+        size_t min = i;
+
+        if ((left < sp->count) && dsched_before(sp, sp->heap[left], sp->heap[min])) {
+            min = left;
+        }
+        if ((right < sp->count) && dsched_before(sp, sp->heap[right], sp->heap[min])) {
+            min = right;
+        }
+        if (min == i) {
+            break;
+        }
+        dsched_swap(sp, i, min);
+        i = min;
+    }
+}
+
+void dsched_init(dsched_t *sp, dsched_task_t **heap, size_t size) {
+    sp->heap = heap;
+    sp->count = 0;
+    sp->size = size;
+    sp->epoch = chVTGetSystemTime();
+    sp->wakeups = 0;
+    sp->dispatched = 0;
+}
+
+void dsched_add(dsched_t *sp, dsched_task_t *tp, dsched_func_t func, void *arg,
+                sysinterval_t delay) {
+    chDbgAssert(sp->count < sp->size, "sched heap full");
+
+    systime_t now = chVTGetSystemTime();
+    if (sp->count == 0U) {
+        sp->epoch = now;
+    }
+
+    tp->deadline = chTimeAddX(now, delay);
+    tp->func = func;
+    tp->arg = arg;
+
+    sp->heap[sp->count] = tp;
+    dsched_sift_up(sp, sp->count);
+    sp->count++;
+}
+
+void dsched_run_once(dsched_t *sp) {
+    chDbgAssert(sp->count > 0U, "sched heap empty");
+
+    // Сон до ближайшего дедлайна. То же, что chThdSleepUntil(), но под одной
+    // блокировкой с чтением времени: уже прошедший дедлайн не будет принят
+    // за момент почти через полный оборот таймера
+    chSysLock();
+    sysinterval_t elapsed = chTimeDiffX(sp->epoch, chVTGetSystemTimeX());
+    sysinterval_t wait = chTimeDiffX(sp->epoch, sp->heap[0]->deadline);
+    if (wait > elapsed) {
+        chThdSleepS(wait - elapsed);
+    }
+    chSysUnlock();
+    sp->wakeups++;
+
+    // Выполняем только наступившие задачи, остальные ждут своего дедлайна
+    systime_t now = chVTGetSystemTime();
+    while (chTimeDiffX(sp->epoch, sp->heap[0]->deadline) <= chTimeDiffX(sp->epoch, now)) {
+        dsched_task_t *tp = sp->heap[0];
+        sp->epoch = tp->deadline;
+
+        sysinterval_t interval = tp->func(tp->arg);
+        chDbgAssert(interval > (sysinterval_t)0, "zero interval");
+        sp->dispatched++;
+
+        // Следующий дедлайн отсчитывается от предыдущего, а не от now,
+        // чтобы период не накапливал дрейф. Если задача отстала больше
+        // чем на период, пропущенные запуски не догоняются пачкой
+        tp->deadline = chTimeAddX(tp->deadline, interval);
+        if (chTimeDiffX(sp->epoch, tp->deadline) <= chTimeDiffX(sp->epoch, now)) {
+            tp->deadline = chTimeAddX(now, interval);
+        }
+        dsched_sift_down(sp, 0);
+    }
+}
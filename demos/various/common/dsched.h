@@ -0,0 +1,39 @@
+#ifndef DSCHED_H
+#define DSCHED_H
+
+#include "ch.h"
+
+// Кооперативный планировщик по дедлайнам для лабораторных с главным циклом.
+// Задачи выполняются до завершения в вызывающем потоке, очередь - двоичная
+// min-куча по времени следующего запуска. Поток спит ровно до ближайшего
+// дедлайна, поэтому число пробуждений равно реальной частоте задач.
+
+// Функция задачи, возвращает интервал до своего следующего запуска
+typedef sysinterval_t (*dsched_func_t)(void *arg);
+
+typedef struct {
+    systime_t deadline; // Момент следующего запуска
+    dsched_func_t func;
+    void *arg;
+} dsched_task_t;
+
+typedef struct {
+    dsched_task_t **heap; // heap[0] - задача с ближайшим дедлайном
+    size_t count;
+    size_t size;
+    systime_t epoch;     // Не позже любого дедлайна в куче, точка отсчета сравнений
+    uint32_t wakeups;    // Пробуждений потока
+    uint32_t dispatched; // Выполненных задач
+} dsched_t;
+
+// heap - массив из size указателей под кучу
+void dsched_init(dsched_t *sp, dsched_task_t **heap, size_t size);
+
+// Первый запуск задачи через delay от текущего момента
+void dsched_add(dsched_t *sp, dsched_task_t *tp, dsched_func_t func, void *arg,
+                sysinterval_t delay);
+
+// Спит до ближайшего дедлайна и выполняет все наступившие задачи
+void dsched_run_once(dsched_t *sp);
+
+#endif
@@ -0,0 +1,76 @@
+#include "lathist.h"
+#include "log.h"
+
+static inline size_t lathist_bucket(uint32_t value) {
+    size_t i = (value > 1U) ? (size_t)(31 - __builtin_clz(value)) : 0U;
+
+    return (i < LATHIST_BUCKETS) ? i : LATHIST_BUCKETS - 1U;
+}
+
+// Исключительная верхняя граница корзины, у последней ее нет
+static inline uint32_t lathist_bound(size_t i) {
+    return (i < LATHIST_BUCKETS - 1U) ? (2U << i) : UINT32_MAX;
+}
+
+void lathist_init(lathist_t *hp) {
+    for (size_t i = 0; i < LATHIST_BUCKETS; i++) {
+        hp->buckets[i] = 0;
+    }
+    hp->count = 0;
+    hp->max = 0;
+    hp->sum = 0;
+}
+
+void lathist_add(lathist_t *hp, rtcnt_t delta) {
+    uint32_t value = (uint32_t)delta;
+
+    hp->buckets[lathist_bucket(value)]++;
+    hp->count++;
+    hp->sum += value;
+    if (value > hp->max) {
+        hp->max = value;
+    }
+}
+
+uint32_t lathist_percentile(const lathist_t *hp, uint32_t percent) {
+    uint64_t rank = ((uint64_t)hp->count * percent + 99U) / 100U;
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < LATHIST_BUCKETS; i++) {
+        seen += hp->buckets[i];
+        if ((seen >= rank) && (seen > 0U)) {
+            // Граница корзины не может быть больше уже виденного максимума
+            uint32_t bound = lathist_bound(i);
+            return (bound < hp->max) ? bound : hp->max;
+        }
+    }
+    return 0;
+}
+
+void lathist_print(const lathist_t *hp, const char *name) {
+    uint32_t count = hp->count;
+
+    if (count == 0U) {
+        log_printf("%s latency: no samples\r\n", name);
+        return;
+    }
+
+    log_printf("%s latency: n=%u, mean=%u, p50<=%u, p99<=%u, max=%u us\r\n",
+               name, count, (uint32_t)(hp->sum / count),
+               lathist_percentile(hp, 50), lathist_percentile(hp, 99), hp->max);
+
+    for (size_t i = 0; i < LATHIST_BUCKETS; i++) {
+        uint32_t n = hp->buckets[i];
+        if (n == 0U) {
+            continue;
+        }
+        uint32_t low = (i == 0U) ? 0U : (1U << i);
+        if (i < LATHIST_BUCKETS - 1U) {
+            log_printf("  [%7u..%7u) us: %6u (%3u%%)\r\n",
+                       low, lathist_bound(i), n, (n * 100U) / count);
+        } else {
+            log_printf("  [%7u..      ) us: %6u (%3u%%)\r\n",
+                       low, n, (n * 100U) / count);
+        }
+    }
+}
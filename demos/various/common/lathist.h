@@ -0,0 +1,33 @@
+#ifndef LATHIST_H
+#define LATHIST_H
+
+#include "ch.h"
+
+// Гистограмма задержек с логарифмическими корзинами: в корзину i попадают
+// значения [2^i, 2^(i+1)) тактов счетчика реального времени, в нулевую - 0 и 1.
+// Значения - разность chSysGetRealtimeCounterX() (на SIMIA32 это мкс).
+// Запись - один поток, чтение (печать) - любой: снимок может быть
+// слегка несогласован, но для мониторинга этого достаточно.
+
+// Число корзин: последняя собирает все, что не меньше 2^(LATHIST_BUCKETS-1)
+#if !defined(LATHIST_BUCKETS)
+#define LATHIST_BUCKETS 24
+#endif
+
+typedef struct {
+    uint32_t buckets[LATHIST_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+} lathist_t;
+
+void lathist_init(lathist_t *hp);
+void lathist_add(lathist_t *hp, rtcnt_t delta);
+
+// Верхняя граница корзины, в которой лежит заданная доля значений (0..100)
+uint32_t lathist_percentile(const lathist_t *hp, uint32_t percent);
+
+// Вывод через log_printf: сводка одной строкой и непустые корзины
+void lathist_print(const lathist_t *hp, const char *name);
+
+#endif
@@ -0,0 +1,128 @@
+#include <string.h>
+#include "chprintf.h"
+#include "ring.h"
+#include "log.h"
+
+// Поток вывода передает chprintf() ровно четыре аргумента
+#if LOG_MAX_ARGS > 4
+#error "LOG_MAX_ARGS above 4 is not supported"
+#endif
+
+typedef struct {
+    const char *fmt; // Формат бинарной записи, NULL - готовый текст
+    rtcnt_t stamp;   // Счетчик реального времени в момент записи
+    size_t len;      // Число аргументов или длина текста
+    union {
+        int32_t args[LOG_MAX_ARGS];
+        char text[LOG_LINE_SIZE];
+    } u;
+} log_record_t;
+
+static BaseSequentialStream *log_out;
+static log_record_t log_data[LOG_RING_SIZE];
+// Производителей много, поэтому запись в кольцо идет под chSysLock();
+// потребитель один - поток вывода, он читает без блокировки
+static ring_t log_ring;
+static binary_semaphore_t log_pending;
+static volatile uint32_t log_drops = 0;
+
+static THD_WORKING_AREA(waLogger, 512);
+static THD_FUNCTION(Logger, arg) {
+    (void)arg;
+    chRegSetThreadName("Logger");
+    uint32_t reported_drops = 0;
+    
+    while (true) {
+        chBSemWait(&log_pending);
+        
+        log_record_t *rec;
+        size_t n = 1;
+        while ((rec = ring_peek_span(&log_ring, &n)) != NULL) {
+            if (rec->fmt != NULL) {
+                // Лишние аргументы формат просто не использует
+                int32_t *a = rec->u.args;
+                chprintf(log_out, "[%10u] ", rec->stamp);
+                chprintf(log_out, rec->fmt, a[0], a[1], a[2], a[3]);
+            } else {
+                streamWrite(log_out, (const uint8_t *)rec->u.text, rec->len);
+            }
+            ring_release(&log_ring, 1);
+            n = 1;
+        }
+        
+        uint32_t drops = log_drops;
+        if (drops != reported_drops) {
+            chprintf(log_out, "[LOG] Dropped %u records\r\n", drops - reported_drops);
+            reported_drops = drops;
+        }
+    }
+}
+
+void log_init(BaseSequentialStream *out) {
+    log_out = out;
+    ring_init(&log_ring, log_data, sizeof(log_record_t), LOG_RING_SIZE);
+    chBSemObjectInit(&log_pending, true);
+    chThdCreateStatic(waLogger, sizeof(waLogger), LOG_THREAD_PRIO, Logger, NULL);
+}
+
+// Кладет готовую запись в кольцо, вызывается под chSysLock()
+static log_record_t *log_reserve_s(void) {
+    log_record_t *rec = ring_reserve(&log_ring, 1);
+    if (rec == NULL) {
+        log_drops++;
+    }
+    return rec;
+}
+
+static void log_commit_s(void) {
+    ring_commit(&log_ring, 1);
+    chBSemSignalI(&log_pending);
+    chSchRescheduleS();
+}
+
+void log_printf(const char *fmt, ...) {
+    char line[LOG_LINE_SIZE];
+    va_list ap;
+    
+    // Форматирование - вне критической секции, в стеке вызывающего
+    va_start(ap, fmt);
+    int len = chvsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (len >= (int)sizeof(line)) {
+        len = (int)sizeof(line) - 1;
+    }
+    
+    chSysLock();
+    log_record_t *rec = log_reserve_s();
+    if (rec != NULL) {
+        rec->fmt = NULL;
+        rec->len = (size_t)len;
+        memcpy(rec->u.text, line, (size_t)len);
+        log_commit_s();
+    }
+    chSysUnlock();
+}
+
+void log_trace_args(const char *fmt, size_t argc, const int32_t *args) {
+    rtcnt_t stamp = chSysGetRealtimeCounterX();
+    
+    chDbgAssert(argc <= LOG_MAX_ARGS, "too many trace arguments");
+    if (argc > LOG_MAX_ARGS) {
+        argc = LOG_MAX_ARGS;
+    }
+    
+    chSysLock();
+    log_record_t *rec = log_reserve_s();
+    if (rec != NULL) {
+        rec->fmt = fmt;
+        rec->stamp = stamp;
+        rec->len = argc;
+        memcpy(rec->u.args, args, argc * sizeof(int32_t));
+        log_commit_s();
+    }
+    chSysUnlock();
+}
+
+uint32_t log_dropped(void) {
+    return log_drops;
+}
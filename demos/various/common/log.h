@@ -0,0 +1,54 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "ch.h"
+#include "hal.h"
+
+// Асинхронный вывод: вызывающий поток только кладет запись в кольцо,
+// в SD1 пишет отдельный низкоприоритетный поток. При переполнении кольца
+// запись отбрасывается и учитывается в счетчике.
+//
+// Записи двух видов:
+//  - текстовые (log_printf) - строка форматируется в стеке вызывающего;
+//  - бинарные (LOG_TRACE) - сохраняются только указатель на строку формата,
+//    метка времени и до LOG_MAX_ARGS целых аргументов, форматирует поток
+//    вывода. Для горячего пути; в формате допустимы только %d/%u/%x.
+
+// Максимальная длина одной записи (с завершающим нулем)
+#if !defined(LOG_LINE_SIZE)
+#define LOG_LINE_SIZE 96
+#endif
+
+// Число записей в кольце, степень двойки
+#if !defined(LOG_RING_SIZE)
+#define LOG_RING_SIZE 32
+#endif
+
+// Максимум целых аргументов бинарной записи
+#if !defined(LOG_MAX_ARGS)
+#define LOG_MAX_ARGS 4
+#endif
+
+// Приоритет потока вывода
+#if !defined(LOG_THREAD_PRIO)
+#define LOG_THREAD_PRIO LOWPRIO
+#endif
+
+void log_init(BaseSequentialStream *out);
+
+// Неблокирующая постановка строки в очередь вывода, можно из любого потока
+void log_printf(const char *fmt, ...);
+
+// Бинарная запись: LOG_TRACE("[PRODUCER] Added: %3d\r\n", num)
+// Нулевой элемент массива - заглушка, чтобы макрос работал и без аргументов
+#define LOG_TRACE(fmt, ...)                                                  \
+    log_trace_args(fmt,                                                      \
+                   sizeof((int32_t[]){0, ##__VA_ARGS__}) / sizeof(int32_t) - 1U, \
+                   &((int32_t[]){0, ##__VA_ARGS__})[1])
+
+void log_trace_args(const char *fmt, size_t argc, const int32_t *args);
+
+// Сколько записей потеряно из-за переполнения кольца
+uint32_t log_dropped(void);
+
+#endif
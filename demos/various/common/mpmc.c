@@ -0,0 +1,83 @@
+#include <string.h>
+#include "mpmc.h"
+
+// Номер последовательности ячейки публикуется с release после копирования
+// элемента и читается с acquire перед копированием: данные ячейки видны
+// другой стороне раньше, чем она увидит новый номер.
+
+static inline size_t *mpmc_seq(mpmc_t *qp, size_t pos) {
+    return (size_t *)(qp->cells + (pos & qp->mask) * qp->cell_size);
+}
+
+static inline uint8_t *mpmc_item(size_t *seqp) {
+    return (uint8_t *)(seqp + 1);
+}
+
+void mpmc_init(mpmc_t *qp, size_t *storage, size_t item_size, size_t capacity) {
+    chDbgAssert((capacity != 0U) && ((capacity & (capacity - 1U)) == 0U),
+                "capacity must be a power of two");
+    
+    qp->cells = (uint8_t *)storage;
+    qp->cell_size = MPMC_CELL_SIZE(item_size);
+    qp->item_size = item_size;
+    qp->mask = capacity - 1U;
+    qp->head = 0;
+    qp->tail = 0;
+    
+    // Ячейка i свободна для записи с индексом i
+    for (size_t i = 0; i < capacity; i++) {
+        *mpmc_seq(qp, i) = i;
+    }
+}
+
+bool mpmc_put(mpmc_t *qp, const void *item) {
+    size_t pos = __atomic_load_n(&qp->head, __ATOMIC_RELAXED);
+    
+    while (true) {
+        size_t *seqp = mpmc_seq(qp, pos);
+        size_t seq = __atomic_load_n(seqp, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)(seq - pos);
+        
+        if (diff == 0) {
+            // Ячейка свободна: занимаем позицию, при неудаче pos обновится
+            if (__atomic_compare_exchange_n(&qp->head, &pos, pos + 1U, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                memcpy(mpmc_item(seqp), item, qp->item_size);
+                __atomic_store_n(seqp, pos + 1U, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            // Ячейку круг назад еще не прочитали - очередь полна
+            return false;
+        } else {
+            // Другой производитель успел раньше
+            pos = __atomic_load_n(&qp->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool mpmc_get(mpmc_t *qp, void *item) {
+    size_t pos = __atomic_load_n(&qp->tail, __ATOMIC_RELAXED);
+    
+    while (true) {
+        size_t *seqp = mpmc_seq(qp, pos);
+        size_t seq = __atomic_load_n(seqp, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)(seq - (pos + 1U));
+        
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&qp->tail, &pos, pos + 1U, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                memcpy(item, mpmc_item(seqp), qp->item_size);
+                // Ячейка свободна для записи на следующем круге
+                __atomic_store_n(seqp, pos + qp->mask + 1U, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            // Данные в ячейку еще не записаны - очередь пуста
+            return false;
+        } else {
+            // Другой потребитель успел раньше
+            pos = __atomic_load_n(&qp->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef MPMC_H
+#define MPMC_H
+
+#include "ch.h"
+#include "ring.h"
+
+// Ограниченная очередь много производителей / много потребителей без
+// блокировок (схема Вьюкова). У каждой ячейки свой номер последовательности:
+// seq == pos - ячейка свободна для записи с индексом pos,
+// seq == pos + 1 - в ячейке данные для чтения с индексом pos.
+// Производители и потребители занимают позицию CAS-ом по head/tail и дальше
+// работают каждый со своей ячейкой, не мешая остальным.
+typedef struct {
+    // Индекс записи, общий для производителей
+    CC_ALIGN_DATA(RING_CACHE_LINE) size_t head;
+    // Индекс чтения, общий для потребителей
+    CC_ALIGN_DATA(RING_CACHE_LINE) size_t tail;
+    // Параметры, неизменные после mpmc_init()
+    CC_ALIGN_DATA(RING_CACHE_LINE) uint8_t *cells;
+    size_t cell_size;
+    size_t item_size;
+    size_t mask;
+} mpmc_t;
+
+// Размер ячейки: номер последовательности + элемент, выровнено по size_t
+#define MPMC_CELL_SIZE(item_size)                                           \
+    ((((item_size) + sizeof(size_t) - 1U) / sizeof(size_t) + 1U) * sizeof(size_t))
+
+// Размер хранилища в size_t: static size_t q_data[MPMC_STORAGE_WORDS(sizeof(int), 16)];
+#define MPMC_STORAGE_WORDS(item_size, capacity)                             \
+    (MPMC_CELL_SIZE(item_size) / sizeof(size_t) * (capacity))
+
+// capacity должна быть степенью двойки, storage - MPMC_STORAGE_WORDS() слов
+void mpmc_init(mpmc_t *qp, size_t *storage, size_t item_size, size_t capacity);
+
+// Неблокирующие операции: false, только если очередь действительно полна / пуста
+bool mpmc_put(mpmc_t *qp, const void *item);
+bool mpmc_get(mpmc_t *qp, void *item);
+
+static inline size_t mpmc_capacity(const mpmc_t *qp) {
+    return qp->mask + 1U;
+}
+
+// Приблизительное число элементов: без блокировок точный снимок невозможен
+static inline size_t mpmc_count(const mpmc_t *qp) {
+    size_t tail = __atomic_load_n(&qp->tail, __ATOMIC_ACQUIRE);
+    size_t count = __atomic_load_n(&qp->head, __ATOMIC_ACQUIRE) - tail;
+
+    return (count > qp->mask) ? qp->mask + 1U : count;
+}
+
+#endif
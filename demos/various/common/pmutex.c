@@ -0,0 +1,74 @@
+#include "pmutex.h"
+#include "log.h"
+
+#if PMUTEX_PROFILING
+
+static pmutex_t *pmutex_list;
+
+void pmutex_init(pmutex_t *mp, const char *name) {
+    chMtxObjectInit(&mp->mtx);
+    mp->name = name;
+    mp->locked_at = 0;
+    mp->locks = 0;
+    mp->contended = 0;
+    mp->wait_max = 0;
+    mp->hold_max = 0;
+    mp->wait_total = 0;
+    mp->hold_total = 0;
+
+    chSysLock();
+    mp->next = pmutex_list;
+    pmutex_list = mp;
+    chSysUnlock();
+}
+
+void pmutex_lock(pmutex_t *mp) {
+    // Сначала без ожидания: так видно, был ли мьютекс занят
+    if (!chMtxTryLock(&mp->mtx)) {
+        rtcnt_t start = chSysGetRealtimeCounterX();
+        chMtxLock(&mp->mtx);
+        uint32_t wait = (uint32_t)(chSysGetRealtimeCounterX() - start);
+
+        mp->contended++;
+        mp->wait_total += wait;
+        if (wait > mp->wait_max) {
+            mp->wait_max = wait;
+        }
+    }
+    mp->locks++;
+    mp->locked_at = chSysGetRealtimeCounterX();
+}
+
+void pmutex_unlock(pmutex_t *mp) {
+    // Счетчики обновляются, пока мьютекс еще наш
+    uint32_t hold = (uint32_t)(chSysGetRealtimeCounterX() - mp->locked_at);
+
+    mp->hold_total += hold;
+    if (hold > mp->hold_max) {
+        mp->hold_max = hold;
+    }
+    chMtxUnlock(&mp->mtx);
+}
+
+void pmutex_report(void) {
+    log_printf("%-10s %8s %8s %9s %9s %9s %9s\r\n", "mutex", "locks", "contend",
+               "wait avg", "wait max", "hold avg", "hold max");
+
+    for (pmutex_t *mp = pmutex_list; mp != NULL; mp = mp->next) {
+        // Согласованный снимок - под самим мьютексом, без учета в статистике
+        chMtxLock(&mp->mtx);
+        uint32_t locks = mp->locks;
+        uint32_t contended = mp->contended;
+        uint32_t wait_avg = (contended > 0U) ? (uint32_t)(mp->wait_total / contended) : 0U;
+        uint32_t wait_max = mp->wait_max;
+        uint32_t hold_avg = (locks > 0U) ? (uint32_t)(mp->hold_total / locks) : 0U;
+        uint32_t hold_max = mp->hold_max;
+        chMtxUnlock(&mp->mtx);
+
+        log_printf("%-10s %8u %8u %9u %9u %9u %9u\r\n", mp->name, locks, contended,
+                   wait_avg, wait_max, hold_avg, hold_max);
+    }
+    log_printf("(times in us, wait avg over contended locks)\r\n");
+}
+
+#endif
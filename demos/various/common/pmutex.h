@@ -0,0 +1,50 @@
+#ifndef PMUTEX_H
+#define PMUTEX_H
+
+#include "ch.h"
+
+// Мьютекс с профилированием: число захватов, захваты с ожиданием, суммарное
+// и максимальное время ожидания и удержания (по счетчику реального времени,
+// на SIMIA32 это мкс). Счетчики меняются только владельцем мьютекса, поэтому
+// своей блокировки не требуют.
+// Включается PMUTEX_PROFILING TRUE в cfg/chconf.h лабы, иначе pmutex_*
+// превращаются в обычные chMtx*.
+
+#if !defined(PMUTEX_PROFILING)
+#define PMUTEX_PROFILING FALSE
+#endif
+
+#if PMUTEX_PROFILING
+
+typedef struct pmutex {
+    mutex_t mtx;
+    const char *name;
+    struct pmutex *next; // Список всех мьютексов для pmutex_report()
+    rtcnt_t locked_at;   // Момент захвата текущим владельцем
+    uint32_t locks;
+    uint32_t contended;  // Захваты, которым пришлось ждать
+    uint32_t wait_max;
+    uint32_t hold_max;
+    uint64_t wait_total;
+    uint64_t hold_total;
+} pmutex_t;
+
+void pmutex_init(pmutex_t *mp, const char *name);
+void pmutex_lock(pmutex_t *mp);
+void pmutex_unlock(pmutex_t *mp);
+
+// Таблица по всем мьютексам через log_printf
+void pmutex_report(void);
+
+#else
+
+typedef mutex_t pmutex_t;
+
+#define pmutex_init(mp, name) ((void)(name), chMtxObjectInit(mp))
+#define pmutex_lock(mp)       chMtxLock(mp)
+#define pmutex_unlock(mp)     chMtxUnlock(mp)
+#define pmutex_report()
+
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+#include "ch.h"
+
+// Маленький генератор псевдослучайных чисел xorshift32 со своим состоянием
+// у каждого владельца: без скрытого глобального состояния и блокировок
+// rand(), последовательность воспроизводится от запуска к запуску.
+typedef struct {
+    uint32_t state; // Никогда не 0
+} prng_t;
+
+// Поток stream от общего seed: номер потока перемешивается (шаги splitmix32),
+// чтобы соседние потоки не давали похожих последовательностей
+static inline void prng_seed(prng_t *pp, uint32_t seed, uint32_t stream) {
+    uint32_t z = seed + stream * 0x9E3779B9U;
+    z = (z ^ (z >> 16)) * 0x85EBCA6BU;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35U;
+    z ^= z >> 16;
+    pp->state = (z != 0U) ? z : 0x6D2B79F5U;
+}
+
+static inline uint32_t prng_next(prng_t *pp) {
+    uint32_t x = pp->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pp->state = x;
+    return x;
+}
+
+// Число в [0, n) умножением со сдвигом, без деления
+static inline uint32_t prng_below(prng_t *pp, uint32_t n) {
+    return (uint32_t)(((uint64_t)prng_next(pp) * n) >> 32);
+}
+
+#endif
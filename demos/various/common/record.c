@@ -0,0 +1,35 @@
+#include <string.h>
+
+#include "record.h"
+
+void record_parser_init(record_parser_t *rpp, uint8_t *buf, size_t size) {
+    rpp->buf = buf;
+    rpp->size = size;
+    rpp->used = 0;
+}
+
+size_t record_parser_commit(record_parser_t *rpp, size_t n,
+                            record_func_t func, void *arg) {
+    size_t records = 0;
+    size_t pos = 0;
+
+    rpp->used += n;
+    while (rpp->used - pos >= RECORD_HEADER_SIZE) {
+        size_t len = (size_t)rpp->buf[pos] | ((size_t)rpp->buf[pos + 1U] << 8);
+        chDbgAssert(RECORD_SIZE(len) <= rpp->size, "record exceeds parser buffer");
+        if (rpp->used - pos < RECORD_SIZE(len)) {
+            break;
+        }
+        func(arg, &rpp->buf[pos + RECORD_HEADER_SIZE], len);
+        pos += RECORD_SIZE(len);
+        records++;
+    }
+
+    // Незавершенная запись переносится в начало буфера
+    if (pos > 0U) {
+        memmove(rpp->buf, &rpp->buf[pos], rpp->used - pos);
+        rpp->used -= pos;
+    }
+
+    return records;
+}
@@ -0,0 +1,50 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "ch.h"
+
+// Записи переменной длины в байтовом потоке (например, pipe_t): 2 байта
+// длины тела (little-endian), затем само тело. Писатель собирает пачку
+// записей в своем буфере и отправляет ее одной операцией, читатель читает
+// сколько есть и разбирает все целые записи, хвост незавершенной ждет
+// следующего чтения.
+
+#define RECORD_HEADER_SIZE 2U
+#define RECORD_MAX_BODY    0xFFFFU
+
+// Полный размер записи с телом len байт
+#define RECORD_SIZE(len) (RECORD_HEADER_SIZE + (len))
+
+// Заголовок записи с телом len байт в dst (места не меньше RECORD_SIZE(len)).
+// Возвращает указатель на тело: писатель заполняет его на месте
+static inline uint8_t *record_start(uint8_t *dst, size_t len) {
+    chDbgAssert(len <= RECORD_MAX_BODY, "record too long");
+
+    dst[0] = (uint8_t)len;
+    dst[1] = (uint8_t)(len >> 8);
+    return &dst[RECORD_HEADER_SIZE];
+}
+
+// Обработчик одной разобранной записи, тело действительно только в вызове
+typedef void (*record_func_t)(void *arg, const uint8_t *body, size_t len);
+
+typedef struct {
+    uint8_t *buf;
+    size_t size; // Не меньше RECORD_SIZE() самой длинной записи
+    size_t used; // Байт прочитано, но еще не разобрано
+} record_parser_t;
+
+void record_parser_init(record_parser_t *rpp, uint8_t *buf, size_t size);
+
+// Куда дочитывать поток: указатель на свободное место, *n - его размер
+static inline uint8_t *record_parser_space(record_parser_t *rpp, size_t *n) {
+    *n = rpp->size - rpp->used;
+    return &rpp->buf[rpp->used];
+}
+
+// Учет n дочитанных байт: func вызывается на каждую целую запись.
+// Возвращает число разобранных записей
+size_t record_parser_commit(record_parser_t *rpp, size_t n,
+                            record_func_t func, void *arg);
+
+#endif
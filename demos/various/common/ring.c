@@ -0,0 +1,189 @@
+#include <string.h>
+#include "ring.h"
+
+// Производитель читает tail потребителя с acquire и публикует head с release,
+// потребитель - наоборот. Данные слота видны другой стороне до нового индекса.
+
+// Копирование n элементов в/из кольца начиная с индекса pos, с заворотом
+static void ring_copy_in(ring_t *rp, size_t pos, const uint8_t *src, size_t n) {
+    size_t idx = pos & rp->mask;
+    size_t first = rp->mask + 1U - idx;
+    if (first > n) {
+        first = n;
+    }
+    
+    memcpy(rp->data + idx * rp->item_size, src, first * rp->item_size);
+    memcpy(rp->data, src + first * rp->item_size, (n - first) * rp->item_size);
+}
+
+static void ring_copy_out(ring_t *rp, size_t pos, uint8_t *dst, size_t n) {
+    size_t idx = pos & rp->mask;
+    size_t first = rp->mask + 1U - idx;
+    if (first > n) {
+        first = n;
+    }
+    
+    memcpy(dst, rp->data + idx * rp->item_size, first * rp->item_size);
+    memcpy(dst + first * rp->item_size, rp->data, (n - first) * rp->item_size);
+}
+
+// Число готовых элементов для потребителя с учетом хвоста массива,
+// пропущенного ring_reserve(): до водяного знака читаем данные, на нем
+// перескакиваем в начало массива. Водяной знак записан до публикации head,
+// поэтому, если он лежит в [tail, head), он актуален; производитель не
+// поставит новый, пока tail не пройдет старый.
+static size_t ring_readable(ring_t *rp, size_t head, size_t *tailp) {
+    size_t tail = rp->tail;
+    size_t wrap = __atomic_load_n(&rp->wrap, __ATOMIC_RELAXED);
+
+    if ((wrap - tail < head - tail) && (wrap != rp->wrap_done)) {
+        if (tail != wrap) {
+            *tailp = tail;
+            return wrap - tail;
+        }
+        rp->wrap_done = wrap;
+        tail += rp->mask + 1U - (tail & rp->mask);
+        __atomic_store_n(&rp->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    *tailp = tail;
+    return head - tail;
+}
+
+void ring_init(ring_t *rp, void *storage, size_t item_size, size_t capacity) {
+    chDbgAssert((capacity > 0U) && ((capacity & (capacity - 1U)) == 0U),
+                "capacity is not a power of two");
+
+    rp->head = 0;
+    rp->wrap = 0;
+    rp->reserve_skip = 0;
+    rp->tail = 0;
+    rp->wrap_done = 0;
+    rp->data = (uint8_t *)storage;
+    rp->item_size = item_size;
+    rp->mask = capacity - 1U;
+}
+
+bool ring_put(ring_t *rp, const void *item) {
+    size_t head = rp->head;
+    size_t tail = __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail > rp->mask) {
+        return false; // Буфер полон
+    }
+
+    memcpy(rp->data + (head & rp->mask) * rp->item_size, item, rp->item_size);
+    __atomic_store_n(&rp->head, head + 1U, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool ring_get(ring_t *rp, void *item) {
+    size_t tail;
+
+    if (ring_readable(rp, __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE), &tail) == 0U) {
+        return false; // Буфер пуст
+    }
+
+    memcpy(item, rp->data + (tail & rp->mask) * rp->item_size, rp->item_size);
+    __atomic_store_n(&rp->tail, tail + 1U, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+size_t ring_put_n(ring_t *rp, const void *src, size_t n) {
+    size_t head = rp->head;
+    size_t tail = __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE);
+    size_t space = rp->mask + 1U - (head - tail);
+
+    if (n > space) {
+        n = space;
+    }
+    if (n > 0U) {
+        ring_copy_in(rp, head, (const uint8_t *)src, n);
+        __atomic_store_n(&rp->head, head + n, __ATOMIC_RELEASE);
+    }
+
+    return n;
+}
+
+size_t ring_get_n(ring_t *rp, void *dst, size_t max) {
+    size_t tail;
+    size_t count = ring_readable(rp, __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE), &tail);
+
+    if (max > count) {
+        max = count;
+    }
+    if (max > 0U) {
+        ring_copy_out(rp, tail, (uint8_t *)dst, max);
+        __atomic_store_n(&rp->tail, tail + max, __ATOMIC_RELEASE);
+    }
+
+    return max;
+}
+
+void *ring_reserve(ring_t *rp, size_t n) {
+    size_t head = rp->head;
+    size_t free = rp->mask + 1U - (head - __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE));
+    size_t idx = head & rp->mask;
+    size_t contig = rp->mask + 1U - idx;
+
+    if ((n <= contig) && (n <= free)) {
+        rp->reserve_skip = 0;
+        return rp->data + idx * rp->item_size;
+    }
+    if ((n > contig) && (contig + n <= free)) {
+        // Хвост массива короче n - пишем с начала, хвост пропускаем
+        rp->reserve_skip = contig;
+        return rp->data;
+    }
+
+    return NULL;
+}
+
+void ring_commit(ring_t *rp, size_t n) {
+    size_t head = rp->head;
+
+    if (n == 0U) {
+        return;
+    }
+    if (rp->reserve_skip > 0U) {
+        __atomic_store_n(&rp->wrap, head, __ATOMIC_RELAXED);
+        head += rp->reserve_skip;
+        rp->reserve_skip = 0;
+    }
+    __atomic_store_n(&rp->head, head + n, __ATOMIC_RELEASE);
+}
+
+void *ring_peek_span(ring_t *rp, size_t *n) {
+    size_t tail;
+    size_t count = ring_readable(rp, __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE), &tail);
+    size_t idx = tail & rp->mask;
+    size_t contig = rp->mask + 1U - idx;
+
+    if (count > contig) {
+        count = contig;
+    }
+    if (*n > count) {
+        *n = count;
+    }
+
+    return (*n > 0U) ? rp->data + idx * rp->item_size : NULL;
+}
+
+void ring_release(ring_t *rp, size_t n) {
+    __atomic_store_n(&rp->tail, rp->tail + n, __ATOMIC_RELEASE);
+}
+
+bool ring_peek(ring_t *rp, size_t index, void *item) {
+    size_t tail = __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE);
+    size_t head = __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE);
+
+    if (index >= head - tail) {
+        return false;
+    }
+
+    memcpy(item, rp->data + ((tail + index) & rp->mask) * rp->item_size, rp->item_size);
+
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef RING_H
+#define RING_H
+
+#include "ch.h"
+
+// Размер строки кэша: head и tail лежат в разных строках,
+// чтобы производитель и потребитель не "дрались" за одну линию
+#define RING_CACHE_LINE 64
+
+// Кольцевой буфер один производитель / один потребитель (SPSC) без блокировок.
+// Индексы head/tail свободно растут и никогда не сбрасываются, количество
+// элементов = head - tail, позиция в массиве = индекс & mask.
+typedef struct {
+    // Индекс записи, изменяется только производителем
+    CC_ALIGN_DATA(RING_CACHE_LINE) size_t head;
+    size_t wrap;         // Водяной знак bip-буфера: индекс начала пропущенного хвоста
+    size_t reserve_skip; // Сколько слотов хвоста пропускает текущий ring_reserve()
+    // Индекс чтения, изменяется только потребителем
+    CC_ALIGN_DATA(RING_CACHE_LINE) size_t tail;
+    size_t wrap_done;    // Последний обработанный водяной знак
+    // Параметры, неизменные после ring_init()
+    CC_ALIGN_DATA(RING_CACHE_LINE) uint8_t *data;
+    size_t item_size;
+    size_t mask;
+} ring_t;
+
+// capacity должна быть степенью двойки, storage - массив из capacity элементов
+void ring_init(ring_t *rp, void *storage, size_t item_size, size_t capacity);
+
+// Неблокирующие операции: false, если буфер полон / пуст
+bool ring_put(ring_t *rp, const void *item);
+bool ring_get(ring_t *rp, void *item);
+
+// Пакетные операции: переносят до n элементов за один раз (не более двух
+// memcpy через точку заворота), возвращают число перенесенных элементов
+size_t ring_put_n(ring_t *rp, const void *src, size_t n);
+size_t ring_get_n(ring_t *rp, void *dst, size_t max);
+
+// Zero-copy интерфейс производителя: непрерывный участок из n слотов для
+// записи на месте. Если до конца массива меньше n слотов, а в начале места
+// хватает, хвост массива пропускается как в bip-буфере. NULL - места нет.
+// ring_commit() публикует первые n (не больше зарезервированных) слотов.
+void *ring_reserve(ring_t *rp, size_t n);
+void ring_commit(ring_t *rp, size_t n);
+
+// Zero-copy интерфейс потребителя: непрерывный участок готовых элементов,
+// *n на входе - сколько нужно, на выходе - сколько доступно подряд.
+// Элементы обрабатываются на месте и освобождаются ring_release().
+void *ring_peek_span(ring_t *rp, size_t *n);
+void ring_release(ring_t *rp, size_t n);
+
+// Чтение элемента с номером index от хвоста без извлечения
+// (не учитывает пропуски bip-буфера, только для вывода состояния)
+bool ring_peek(ring_t *rp, size_t index, void *item);
+
+static inline size_t ring_capacity(const ring_t *rp) {
+    return rp->mask + 1U;
+}
+
+// Со стороны третьего потока (монитор) значение приблизительное,
+// пропущенные ring_reserve() слоты считаются занятыми
+static inline size_t ring_count(const ring_t *rp) {
+    size_t tail = __atomic_load_n(&rp->tail, __ATOMIC_ACQUIRE);
+    size_t count = __atomic_load_n(&rp->head, __ATOMIC_ACQUIRE) - tail;
+
+    return (count > rp->mask) ? rp->mask + 1U : count;
+}
+
+static inline bool ring_is_empty(const ring_t *rp) {
+    return ring_count(rp) == 0U;
+}
+
+static inline bool ring_is_full(const ring_t *rp) {
+    return ring_count(rp) == ring_capacity(rp);
+}
+
+// Индексы в массиве для вывода состояния (как head/tail в старых буферах)
+static inline size_t ring_head_pos(const ring_t *rp) {
+    return rp->head & rp->mask;
+}
+
+static inline size_t ring_tail_pos(const ring_t *rp) {
+    return rp->tail & rp->mask;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include "rwlock.h"
+
+void rwlock_init(rwlock_t *rwp) {
+    chMtxObjectInit(&rwp->mtx);
+    chCondObjectInit(&rwp->readers_cv);
+    chCondObjectInit(&rwp->writers_cv);
+    rwp->readers = 0;
+    rwp->writers_waiting = 0;
+    rwp->writer = false;
+}
+
+// Ожидание на условной переменной с учетом уже прошедшего времени, вызывается
+// с захваченным мьютексом. При MSG_TIMEOUT ChibiOS не захватывает мьютекс
+// обратно, поэтому здесь он захватывается заново: вызывающий всегда
+// продолжает под мьютексом
+static msg_t rwlock_wait(rwlock_t *rwp, condition_variable_t *cp,
+                         systime_t start, sysinterval_t timeout) {
+    if (timeout == TIME_INFINITE) {
+        return chCondWait(cp);
+    }
+
+    sysinterval_t elapsed = chTimeDiffX(start, chVTGetSystemTime());
+    if (elapsed >= timeout) {
+        return MSG_TIMEOUT;
+    }
+
+    msg_t msg = chCondWaitTimeout(cp, timeout - elapsed);
+    if (msg == MSG_TIMEOUT) {
+        chMtxLock(&rwp->mtx);
+    }
+    return msg;
+}
+
+msg_t rwlock_read_lock_timeout(rwlock_t *rwp, sysinterval_t timeout) {
+    systime_t start = chVTGetSystemTime();
+
+    chMtxLock(&rwp->mtx);
+    // Приоритет писателей: ждем и активного, и ждущих
+    while (rwp->writer || (rwp->writers_waiting > 0U)) {
+        if (rwlock_wait(rwp, &rwp->readers_cv, start, timeout) == MSG_TIMEOUT) {
+            chMtxUnlock(&rwp->mtx);
+            return MSG_TIMEOUT;
+        }
+    }
+    rwp->readers++;
+    chMtxUnlock(&rwp->mtx);
+
+    return MSG_OK;
+}
+
+msg_t rwlock_write_lock_timeout(rwlock_t *rwp, sysinterval_t timeout) {
+    systime_t start = chVTGetSystemTime();
+
+    chMtxLock(&rwp->mtx);
+    rwp->writers_waiting++;
+    while (rwp->writer || (rwp->readers > 0U)) {
+        if (rwlock_wait(rwp, &rwp->writers_cv, start, timeout) == MSG_TIMEOUT) {
+            // Последний ушедший писатель пропускает придержанных им читателей
+            rwp->writers_waiting--;
+            if ((rwp->writers_waiting == 0U) && !rwp->writer) {
+                chCondBroadcast(&rwp->readers_cv);
+            }
+            chMtxUnlock(&rwp->mtx);
+            return MSG_TIMEOUT;
+        }
+    }
+    rwp->writers_waiting--;
+    rwp->writer = true;
+    chMtxUnlock(&rwp->mtx);
+
+    return MSG_OK;
+}
+
+void rwlock_read_unlock(rwlock_t *rwp) {
+    chMtxLock(&rwp->mtx);
+    chDbgAssert(rwp->readers > 0U, "not read locked");
+    rwp->readers--;
+    if ((rwp->readers == 0U) && (rwp->writers_waiting > 0U)) {
+        chCondSignal(&rwp->writers_cv);
+    }
+    chMtxUnlock(&rwp->mtx);
+}
+
+void rwlock_write_unlock(rwlock_t *rwp) {
+    chMtxLock(&rwp->mtx);
+    chDbgAssert(rwp->writer, "not write locked");
+    rwp->writer = false;
+    // Сначала следующий писатель, читатели - только когда писателей нет
+    if (rwp->writers_waiting > 0U) {
+        chCondSignal(&rwp->writers_cv);
+    } else {
+        chCondBroadcast(&rwp->readers_cv);
+    }
+    chMtxUnlock(&rwp->mtx);
+}
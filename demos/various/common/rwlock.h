@@ -0,0 +1,43 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include "ch.h"
+
+// Блокировка читатели/писатель на мьютексе и двух условных переменных.
+// Читатели работают параллельно, писатель - монопольно. Приоритет у
+// писателей: пока писатель ждет, новые читатели не допускаются.
+typedef struct {
+    mutex_t mtx;
+    condition_variable_t readers_cv; // Ждущие читатели
+    condition_variable_t writers_cv; // Ждущие писатели
+    uint32_t readers;                // Активных читателей
+    uint32_t writers_waiting;        // Ждущих писателей
+    bool writer;                     // Активен писатель
+} rwlock_t;
+
+void rwlock_init(rwlock_t *rwp);
+
+// MSG_OK - блокировка захвачена, MSG_TIMEOUT - истек timeout
+// (TIME_IMMEDIATE - без ожидания, TIME_INFINITE - без ограничения)
+msg_t rwlock_read_lock_timeout(rwlock_t *rwp, sysinterval_t timeout);
+msg_t rwlock_write_lock_timeout(rwlock_t *rwp, sysinterval_t timeout);
+void rwlock_read_unlock(rwlock_t *rwp);
+void rwlock_write_unlock(rwlock_t *rwp);
+
+static inline void rwlock_read_lock(rwlock_t *rwp) {
+    (void)rwlock_read_lock_timeout(rwp, TIME_INFINITE);
+}
+
+static inline void rwlock_write_lock(rwlock_t *rwp) {
+    (void)rwlock_write_lock_timeout(rwp, TIME_INFINITE);
+}
+
+static inline bool rwlock_try_read_lock(rwlock_t *rwp) {
+    return rwlock_read_lock_timeout(rwp, TIME_IMMEDIATE) == MSG_OK;
+}
+
+static inline bool rwlock_try_write_lock(rwlock_t *rwp) {
+    return rwlock_write_lock_timeout(rwp, TIME_IMMEDIATE) == MSG_OK;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "stats.h"
+#include "log.h"
+
+#if STATS_ENABLED
+
+// Все поля ниже меняются только из хуков, т.е. под блокировкой ядра
+static rtcnt_t stats_last;       // Момент последнего переключения
+static uint64_t stats_elapsed;   // Время до stats_last
+static rtcnt_t stats_idle_since; // Момент входа в простой
+static uint64_t stats_idle_time;
+static uint32_t stats_idle_entries;
+
+void stats_init(void) {
+    stats_last = chSysGetRealtimeCounterX();
+    stats_elapsed = 0;
+    stats_idle_time = 0;
+    stats_idle_entries = 0;
+}
+
+void stats_thread_init(thread_t *tp) {
+    tp->stats_switches = 0;
+    tp->stats_runtime = 0;
+}
+
+// Время с прошлого переключения целиком достается уходящему потоку.
+// Разности 32-битного счетчика корректны при переполнении, пока поток
+// не работает без переключений дольше периода счетчика
+void stats_switch(thread_t *ntp, thread_t *otp) {
+    rtcnt_t now = chSysGetRealtimeCounterX();
+    rtcnt_t delta = now - stats_last;
+
+    stats_last = now;
+    stats_elapsed += delta;
+    otp->stats_runtime += delta;
+    ntp->stats_switches++;
+}
+
+// Хуки простоя вызываются потоком простоя без блокировки ядра, а 64-битное
+// время простоя читает stats_snapshot() под ней. Блокировка - с сохранением
+// состояния: так хук корректен и без критической секции, и внутри нее
+void stats_idle_enter(void) {
+    syssts_t sts = chSysGetStatusAndLockX();
+    stats_idle_since = chSysGetRealtimeCounterX();
+    stats_idle_entries++;
+    chSysRestoreStatusX(sts);
+}
+
+void stats_idle_leave(void) {
+    syssts_t sts = chSysGetStatusAndLockX();
+    stats_idle_time += chSysGetRealtimeCounterX() - stats_idle_since;
+    chSysRestoreStatusX(sts);
+}
+
+void stats_snapshot(stats_snapshot_t *sp) {
+    thread_t *self = chThdGetSelfX();
+    thread_t *idle = chSysGetIdleThreadX();
+
+    // Текущий отрезок еще не учтен: он идет вызывающему потоку
+    chSysLock();
+    rtcnt_t pending = chSysGetRealtimeCounterX() - stats_last;
+    sp->elapsed = stats_elapsed + pending;
+    sp->idle = stats_idle_time;
+    sp->idle_entries = stats_idle_entries;
+    chSysUnlock();
+
+    // Обход реестра целиком: прерванный обход оставил бы ссылку на поток
+    sp->count = 0;
+    for (thread_t *tp = chRegFirstThread(); tp != NULL; tp = chRegNextThread(tp)) {
+        if ((tp == idle) || (sp->count >= STATS_MAX_THREADS)) {
+            continue;
+        }
+        stats_thread_t *stp = &sp->threads[sp->count++];
+
+        stp->name = chRegGetThreadNameX(tp);
+        chSysLock();
+        stp->switches = tp->stats_switches;
+        stp->runtime = tp->stats_runtime;
+        chSysUnlock();
+        if (tp == self) {
+            stp->runtime += pending;
+        }
+    }
+}
+
+// Доля в десятых процента
+static uint32_t stats_permille(uint64_t part, uint64_t whole) {
+    return (whole > 0U) ? (uint32_t)((part * 1000U) / whole) : 0U;
+}
+
+void stats_print(const stats_snapshot_t *sp) {
+    for (size_t i = 0; i < sp->count; i++) {
+        const stats_thread_t *stp = &sp->threads[i];
+        uint32_t pm = stats_permille(stp->runtime, sp->elapsed);
+
+        log_printf("%-8s switches=%7u, run=%8u ms (%3u.%u%%)\r\n",
+                   (stp->name != NULL) ? stp->name : "?", stp->switches,
+                   (uint32_t)(stp->runtime / 1000U), pm / 10U, pm % 10U);
+    }
+
+    uint32_t pm = stats_permille(sp->idle, sp->elapsed);
+    log_printf("Idle: %3u.%u%% of %u ms, %u entries\r\n", pm / 10U, pm % 10U,
+               (uint32_t)(sp->elapsed / 1000U), sp->idle_entries);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "ch.h"
+
+// Учет процессорного времени потоков на хуках ядра. Лаба подключает его в
+// своем cfg/chconf.h: STATS_ENABLED TRUE, поля stats_switches/stats_runtime
+// в CH_CFG_THREAD_EXTRA_FIELDS и вызовы хуков ниже из CH_CFG_*_HOOK.
+// Время - по счетчику реального времени (на SIMIA32 это мкс), отсчет - с
+// chSysInit().
+
+#if !defined(STATS_ENABLED)
+#define STATS_ENABLED FALSE
+#endif
+
+// Сколько потоков помещается в снимок, остальные не попадают в таблицу
+#if !defined(STATS_MAX_THREADS)
+#define STATS_MAX_THREADS 8
+#endif
+
+typedef struct {
+    const char *name;
+    uint32_t switches; // Сколько раз поток получал процессор
+    uint64_t runtime;  // Суммарное время выполнения
+} stats_thread_t;
+
+typedef struct {
+    uint64_t elapsed;      // Время с начала учета
+    uint64_t idle;         // Время в потоке простоя
+    uint32_t idle_entries; // Сколько раз система уходила в простой
+    size_t count;
+    stats_thread_t threads[STATS_MAX_THREADS]; // Без потока простоя
+} stats_snapshot_t;
+
+#if STATS_ENABLED
+// Хуки, вызываются ядром в критической секции
+void stats_init(void);
+void stats_thread_init(thread_t *tp);
+void stats_switch(thread_t *ntp, thread_t *otp);
+
+// Хуки простоя, вызываются потоком простоя вне критической секции;
+// счетчики обновляют сами под блокировкой ядра
+void stats_idle_enter(void);
+void stats_idle_leave(void);
+
+// Снимок счетчиков всех потоков из реестра, вызывать вне критической секции
+void stats_snapshot(stats_snapshot_t *sp);
+
+// Вывод снимка через log_printf: строка на поток и доля простоя
+void stats_print(const stats_snapshot_t *sp);
+#endif
+
+#endif